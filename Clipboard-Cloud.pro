@@ -10,26 +10,62 @@ CONFIG += c++17
 
 SOURCES += \
     QRcode/qrcodegen.cpp \
+    capturepipeline.cpp \
+    deferredmimedata.cpp \
+    deltasync.cpp \
+    encodecache.cpp \
+    filetransfer.cpp \
+    imagecodec.cpp \
+    jpegstripencoder.cpp \
+    lanpeer.cpp \
     main.cpp \
+    outboxjournal.cpp \
+    payloadcipher.cpp \
+    pushchannel.cpp \
+    receivepipeline.cpp \
     third-party/WinToast/src/wintoastlib.cpp \
     tipwidget.cpp \
+    uploadqueue.cpp \
     util.cpp \
-    widget.cpp
+    widget.cpp \
+    wireformat.cpp \
+    wirestreamdecoder.cpp
 
 HEADERS += \
     QRcode/QRUtil.h \
     QRcode/qrcodegen.hpp \
+    capturepipeline.h \
+    clipcoalescer.h \
+    deferredmimedata.h \
+    deltasync.h \
+    encodecache.h \
+    filetransfer.h \
+    imagecodec.h \
+    jpegstripencoder.h \
+    lanpeer.h \
+    outboxjournal.h \
+    payloadcipher.h \
+    pushchannel.h \
+    receivepipeline.h \
+    reconnectbackoff.h \
     third-party/WinToast/include/wintoastlib.h \
     tipwidget.h \
     toastHandler.h \
+    uplinkmeter.h \
+    uploadqueue.h \
     util.h \
     webIconFetcher.h \
-    widget.h
+    widget.h \
+    wireformat.h \
+    wirestreamdecoder.h
 
 FORMS += \
     tipwidget.ui \
     widget.ui
 
+LIBS += -lbcrypt # PayloadCipher: Windows CNG AES-GCM
+LIBS += -lcrypt32 # Util::protectData: DPAPI
+
 INCLUDEPATH += \
     third-party/WinToast/include
 
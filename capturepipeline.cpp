@@ -0,0 +1,215 @@
+#include "capturepipeline.h"
+#include "util.h"
+#include "payloadcipher.h"
+#include "filetransfer.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QMimeData>
+#include <QRegularExpression>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QDebug>
+
+QByteArray CapturePipeline::WireOptions::key() const
+{
+    return QByteArray::number(binary) + QByteArray::number(deflate) + QByteArray::number(quintptr(cipher.data()));
+}
+
+CapturePipeline::CapturePipeline(QObject* parent)
+    : QObject(parent)
+{
+    pool = new QThreadPool(this);
+    pool->setMaxThreadCount(2); // 过时的任务还在编码时，新内容无需排队等待
+    hashPool = new QThreadPool(this);
+    hashPool->setMaxThreadCount(1);
+}
+
+CapturePipeline::~CapturePipeline()
+{
+    generation.fetchAndAddOrdered(1); // 作废所有任务
+    hashPool->clear();
+    pool->clear();
+    hashPool->waitForDone();
+    pool->waitForDone();
+}
+
+ClipSnapshot CapturePipeline::grab()
+{
+    QElapsedTimer timer;
+    timer.start();
+    ClipSnapshot snapshot;
+    const QMimeData* clipData = qApp->clipboard()->mimeData();
+    if (clipData->formats().isEmpty()) { //复制 then [粘贴文件]的时候，剪贴板会变化，并且formats为空，WTF？
+        qWarning() << "WARN: No formats";
+        return snapshot;
+    }
+
+    // 资源管理器中复制的文件：只记录路径和大小，内容在上传时流式读取；文件夹等不支持的情况仍按文本（路径）发送
+    if (clipData->hasUrls() && clipData->urls().first().isLocalFile()) {
+        QString error;
+        snapshot.files = FileTransfer::collect(clipData->urls(), &error);
+        if (!snapshot.files.isEmpty()) {
+            snapshot.isText = false;
+            snapshot.grabMs = timer.elapsed();
+            return snapshot;
+        }
+        qWarning() << "WARN: Unable to send as files, fallback to text." << error;
+    }
+
+    snapshot.isText = !clipData->hasImage(); //有可能同时hasText，所以以image为准
+    if (clipData->hasImage()) {
+        static auto extractFilePath = [](const QString& str) {
+            static QRegularExpression re("filepath=\"([^\"]*)\"");
+            QRegularExpressionMatch match = re.match(str);
+            if (match.hasMatch()) {
+                return match.captured(1);
+            } else {
+                return QString();
+            }
+        };
+
+        // 貌似不同软件的mime格式不一样，这里只处理QQ
+        // "<QQRichEditFormat><Info version=\"1001\"></Info><EditElement type=\"1\" imagebiztype=\"7\" textsummary=\"[崇拜]\"
+        // filepath=\"E:\\xxx\\Tencent Files\\xxx\\Image\\C2C\\Image8\\a611951b0d...681d24c21a94c.gif\" shortcut=\"\">
+        // </EditElement></QQRichEditFormat>"
+        auto qqRichData = QString::fromUtf8(clipData->data("application/x-qt-windows-mime;value=\"QQ_Unicode_RichEdit_Format\""));
+        auto imagePath = extractFilePath(qqRichData); // 正则提取路径
+        // .gif 特殊处理，因为QImage不支持gif的Write，如果直接转换为jpg只会保留一帧；文件在工作线程中读取
+        if (imagePath.endsWith(".gif") && QFile::exists(imagePath)) {
+            snapshot.filePath = imagePath;
+        } else {
+            //format: application/x-qt-image
+            snapshot.image = qvariant_cast<QImage>(clipData->imageData()); //不能直接toByteArray，需要先转换为QImage，否则为空
+            if (snapshot.image.isNull())
+                qWarning() << "WARN: QImage is null";
+        }
+    } else if (clipData->hasText()) {
+        snapshot.text = clipData->text().toUtf8();
+    } else {
+        qWarning() << "WARN: This Type is not supported NOW." << clipData->formats();
+    }
+    snapshot.grabMs = timer.elapsed();
+    return snapshot;
+}
+
+void CapturePipeline::fingerprint(const ClipSnapshot& snapshot, FingerprintCallback cb)
+{
+    QPointer<CapturePipeline> self(this);
+    hashPool->start([=]() {
+        QElapsedTimer timer;
+        timer.start();
+        ClipSnapshot hashed = snapshot;
+        if (!snapshot.files.isEmpty() || !snapshot.filePath.isEmpty()) { // 文件：路径 + 大小 + 修改时间，内容不读取
+            QStringList paths;
+            for (const ClipFile& file : snapshot.files) paths << file.path;
+            if (paths.isEmpty()) paths << snapshot.filePath;
+            QByteArray identity;
+            for (const QString& path : paths) {
+                const QFileInfo info(path);
+                identity += path.toUtf8() + '\0' + QByteArray::number(info.size()) + '\0'
+                            + QByteArray::number(info.lastModified().toMSecsSinceEpoch()) + '\0';
+            }
+            hashed.fingerprint = Util::fingerprint(identity.constData(), size_t(identity.size()));
+        } else if (snapshot.isText) {
+            hashed.fingerprint = Util::fingerprint(snapshot.text.constData(), size_t(snapshot.text.size()));
+        } else { // 图像只哈希像素，不依赖编码结果
+            const QImage& image = snapshot.image;
+            hashed.fingerprint = Util::fingerprint(image.constBits(), size_t(image.sizeInBytes())) ^ (quint64(image.width()) << 32 | quint64(image.height()));
+        }
+        hashed.hashMs = timer.elapsed();
+        QMetaObject::invokeMethod(self, [=]() { // 回到GUI线程
+            if (self) cb(hashed);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void CapturePipeline::submit(const ClipSnapshot& snapshot, const ClipPayload& meta, const WireOptions& wire, const ImageCodec::Budget& budget, Callback cb)
+{
+    const quint64 gen = generation.fetchAndAddOrdered(1) + 1;
+    QPointer<CapturePipeline> self(this);
+    pool->start([=]() {
+        if (isStale(gen)) return; // 排队期间已有更新的内容
+
+        QElapsedTimer timer;
+        qint64 encodeMs = 0, wireMs = 0;
+        ClipPayload payload = meta;
+        payload.isText = snapshot.isText;
+        const quint64 fingerprint = snapshot.fingerprint;
+        QString reduction;
+
+        QList<ClipFile> files = snapshot.files;
+        if (!snapshot.filePath.isEmpty() && QFileInfo(snapshot.filePath).size() > WireFormat::maxDataSize(wire.binary)) {
+            // 放不进请求体的 gif 不整个读入内存，改为按复制的文件发送（流式上传）
+            qDebug() << "Info: Large gif, send as a file:" << snapshot.filePath;
+            files = FileTransfer::collect({QUrl::fromLocalFile(snapshot.filePath)});
+        }
+        if (!files.isEmpty()) { // 文件：内容不读取，指纹已在 fingerprint() 中按元数据计算
+            payload.isText = false;
+            payload.files = files;
+            payload.fingerprint = fingerprint;
+            qDebug().noquote() << QString("Capture pipeline: grab %1 ms | stat %2 ms; %3 file(s), %4")
+                                  .arg(snapshot.grabMs).arg(snapshot.hashMs).arg(payload.files.size())
+                                  .arg(Util::printDataSize(FileTransfer::totalSize(payload.files)));
+            QMetaObject::invokeMethod(self, [=]() {
+                if (!self || self->isStale(gen)) return;
+                cb(payload, fingerprint, QString());
+            }, Qt::QueuedConnection);
+            return;
+        }
+
+        // 命中缓存则跳过编码（gif 也不必再读文件）
+        timer.start();
+        if (snapshot.isText) payload.data = snapshot.text;
+
+        ImageCodec::Budget imageBudget = budget;
+        imageBudget.maxBytes = qMin(budget.maxBytes, WireFormat::maxDataSize(wire.binary));
+        EncodeCache::Entry cached;
+        // 字节预算变小（如网速变慢）时，缓存的编码结果可能放不下，需要重新编码
+        const bool hit = cache.lookup(fingerprint, &cached) && (snapshot.isText || cached.data.size() <= imageBudget.maxBytes);
+        if (hit) {
+            payload.data = cached.data;
+            reduction = cached.reduction;
+            if (cached.wireKey == wire.key()) {
+                payload.wire = cached.wire;
+                payload.wireKey = cached.wireKey;
+            }
+        } else if (!snapshot.filePath.isEmpty()) {
+            QFile file(snapshot.filePath); // 大小已确认在请求体上限以内
+            if (file.open(QIODevice::ReadOnly))
+                payload.data = file.read(WireFormat::maxDataSize(wire.binary));
+            else
+                qCritical() << "Unable to open the file:" << snapshot.filePath;
+        } else if (!snapshot.isText) {
+            // 按内容选择 png / webp / jpg（含格式转换），放不下时降质、缩小
+            const ImageCodec::Result encoded = ImageCodec::encode(snapshot.image, imageBudget);
+            payload.data = encoded.data;
+            reduction = encoded.reduction;
+        }
+        encodeMs = timer.restart();
+        if (payload.data.isEmpty() || isStale(gen)) return;
+
+        // 线上格式预编码（base64 / deflate / 加密），发送时选项一致则直接使用
+        if (payload.wire.isEmpty()) {
+            payload.wire = wire.binary ? WireFormat::encodeBinary(payload, wire.deflate, wire.cipher.data())
+                                       : WireFormat::encodeJson(payload, wire.cipher.data());
+            payload.wireKey = wire.key();
+        }
+        payload.fingerprint = fingerprint;
+        wireMs = timer.elapsed();
+        if (!hit || cached.wire != payload.wire)
+            cache.insert(fingerprint, {payload.data, payload.wire, payload.wireKey, reduction});
+
+        qDebug().noquote() << QString("Capture pipeline: grab %1 ms | hash %2 ms | encode %3 ms | wire %4 ms; %5%6")
+                              .arg(snapshot.grabMs).arg(snapshot.hashMs).arg(encodeMs).arg(wireMs)
+                              .arg(Util::printDataSize(payload.data.size()))
+                              .arg(hit ? QString(" (cache hit #%1)").arg(cache.hitCount()) : QString());
+
+        QMetaObject::invokeMethod(self, [=]() { // 回到GUI线程
+            if (!self || self->isStale(gen)) return; // 编码期间已有更新的内容
+            cb(payload, fingerprint, reduction);
+        }, Qt::QueuedConnection);
+    });
+}
@@ -0,0 +1,74 @@
+#ifndef CAPTUREPIPELINE_H
+#define CAPTUREPIPELINE_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QImage>
+#include <QSharedPointer>
+#include <QAtomicInteger>
+#include <functional>
+#include "wireformat.h"
+#include "imagecodec.h"
+#include "encodecache.h"
+
+class PayloadCipher;
+
+// 剪贴板在GUI线程上抓取的原始内容（只做必要的、廉价的读取）
+struct ClipSnapshot {
+    bool isText = true;
+    QByteArray text;  // UTF-8
+    QImage image;     // 隐式共享，跨线程传值安全
+    QString filePath; // 直接上传原文件（如QQ的gif，QImage 写出只会保留一帧）
+    QList<ClipFile> files; // 复制的文件（见 FileTransfer），内容不读入内存
+    qint64 grabMs = 0;
+    quint64 fingerprint = 0; // 由 CapturePipeline::fingerprint() 填写
+    qint64 hashMs = 0;
+
+    bool isEmpty(void) const { return isText ? text.isEmpty() : image.isNull() && filePath.isEmpty() && files.isEmpty(); }
+};
+
+// 采集流水线：GUI线程只负责 grab()，图像编码（见 ImageCodec）、指纹、线上格式编码（deflate / 加密 / base64）都在线程池中完成
+// 4K多屏截图的 jpg 编码要数百毫秒，放在GUI线程会卡住托盘
+// 分两步：
+// - fingerprint()：对原始内容取指纹，单线程串行，每个剪贴板事件都计算且按提交顺序回调，供 ClipCoalescer 逐个事件合并、计数
+// - submit()：编码，latest-wins：新的剪贴板内容提交后，尚未开始 / 已过时的旧任务直接丢弃；编码结果按指纹缓存（见 EncodeCache）
+// 复制的文件、QQ的gif只取路径 + 大小 + 修改时间的指纹，不读取内容；复制的文件也不编码、不缓存，上传时再流式读取
+class CapturePipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 预编码请求体所用的选项；发送时选项不一致（如服务端刚协商为二进制格式）则由发送方重新编码
+    struct WireOptions {
+        bool binary = false;
+        bool deflate = false;
+        QSharedPointer<const PayloadCipher> cipher;
+
+        QByteArray key(void) const;
+    };
+    // reduction 非空表示图像被降质 / 缩小以放进字节预算（见 ImageCodec::Result）
+    using Callback = std::function<void(const ClipPayload& payload, quint64 fingerprint, const QString& reduction)>;
+    using FingerprintCallback = std::function<void(const ClipSnapshot& snapshot)>; // snapshot 已填好 fingerprint
+
+    explicit CapturePipeline(QObject* parent = nullptr);
+    ~CapturePipeline();
+
+    static ClipSnapshot grab(void); // 只能在GUI线程调用
+    // 在GUI线程按提交顺序回调，不会被更新的内容取代
+    void fingerprint(const ClipSnapshot& snapshot, FingerprintCallback cb);
+    // snapshot 须已取指纹；meta 提供 os / origin 等元数据；图像字节预算不会超过请求体上限；完成后在GUI线程回调（被更新的内容取代时不回调）
+    void submit(const ClipSnapshot& snapshot, const ClipPayload& meta, const WireOptions& wire, const ImageCodec::Budget& budget, Callback cb);
+
+    EncodeCache& encodeCache(void) { return cache; }
+
+private:
+    bool isStale(quint64 gen) const { return gen != generation.loadAcquire(); }
+
+private:
+    QThreadPool* pool = nullptr;
+    QThreadPool* hashPool = nullptr; // 单线程，保证指纹回调的顺序
+    QAtomicInteger<quint64> generation = 0;
+    EncodeCache cache; // 相同内容（重复复制、剪贴板管理器重新声明所有权）只哈希，不重新编码
+};
+
+#endif // CAPTUREPIPELINE_H
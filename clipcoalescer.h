@@ -0,0 +1,40 @@
+#ifndef CLIPCOALESCER_H
+#define CLIPCOALESCER_H
+
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+// 剪贴板事件合并器：同一内容在“静默窗口”内的重复变化只上传一次
+// 窗口是滑动的：每次重复事件都会顺延窗口，所以一次突发（如hexo复制按钮的17次修改）只会产生一次上传
+// 窗口过后再次复制相同内容，视为用户有意为之，照常上传
+// 内容不同则立即上传，不引入额外延迟
+// 指纹在工作线程中计算，判断时已晚于事件本身：窗口按事件发生的时间（now()）计算，而不是判断的时间
+class ClipCoalescer {
+public:
+    explicit ClipCoalescer(int quietWindowMs = 500) : quietWindowMs(quietWindowMs) { clock.start(); }
+
+    qint64 now() const { return clock.elapsed(); } // 事件发生时记下，传给 accept()
+
+    // 须按事件顺序调用；返回 true 表示应当上传
+    bool accept(quint64 fingerprint, qint64 eventMs) {
+        const bool inWindow = lastEventMs >= 0 && eventMs - lastEventMs < quietWindowMs;
+        lastEventMs = eventMs;
+        if (inWindow && fingerprint == lastFingerprint) {
+            suppressed++;
+            return false;
+        }
+        lastFingerprint = fingerprint;
+        return true;
+    }
+
+    quint64 suppressedCount() const { return suppressed; }
+
+private:
+    int quietWindowMs;
+    quint64 lastFingerprint = 0;
+    quint64 suppressed = 0;
+    qint64 lastEventMs = -1;
+    QElapsedTimer clock;
+};
+
+#endif // CLIPCOALESCER_H
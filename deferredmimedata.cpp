@@ -0,0 +1,51 @@
+#include "deferredmimedata.h"
+#include <QFile>
+#include <QDebug>
+
+const QString DeferredMimeData::JFIF_MIME = "application/x-qt-windows-mime;value=\"JFIF\"";
+
+DeferredMimeData::DeferredMimeData(const ReceivedImage& image)
+    : source(image)
+{
+    // 只按元数据声明，不读取任何内容
+    if (!source.image.isNull())
+        announced << "application/x-qt-image";
+    if (!source.mimeType.isEmpty()) {
+        announced << source.mimeType;
+        if (source.mimeType == "image/jpeg") announced << JFIF_MIME;
+    }
+}
+
+DeferredMimeData::~DeferredMimeData()
+{
+    if (!source.encodedFile.isEmpty()) QFile::remove(source.encodedFile);
+}
+
+QStringList DeferredMimeData::formats() const
+{
+    return announced;
+}
+
+bool DeferredMimeData::hasFormat(const QString& mimeType) const
+{
+    return announced.contains(mimeType);
+}
+
+QVariant DeferredMimeData::retrieveData(const QString& mimeType, QVariant::Type type) const
+{
+    if (!announced.contains(mimeType)) return QMimeData::retrieveData(mimeType, type);
+    if (mimeType == "application/x-qt-image") return source.image;
+    qDebug() << "Clipboard: render" << mimeType << "on request";
+    return encodedBytes();
+}
+
+QByteArray DeferredMimeData::encodedBytes() const
+{
+    if (source.encodedFile.isEmpty()) return source.encoded;
+    QFile file(source.encodedFile); // 不缓存：大图只在粘贴的这一刻占用内存
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "WARN: Unable to read the received image:" << source.encodedFile << file.errorString();
+        return {};
+    }
+    return file.readAll();
+}
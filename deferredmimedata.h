@@ -0,0 +1,37 @@
+#ifndef DEFERREDMIMEDATA_H
+#define DEFERREDMIMEDATA_H
+
+#include <QMimeData>
+#include "receivepipeline.h"
+
+// 延迟渲染的剪贴板数据：formats() 先声明所有格式，retrieveData() 在使用方请求某个格式时才准备数据
+// - 原始编码字节（image/jpeg 等）：落盘的大图在粘贴时才从文件读取，平时不占内存
+// - 位图：Qt 的 Windows 后端按请求转换为 CF_DIB / CF_DIBV5，本身就是延迟的
+//   位图的解码无法推迟到这里：Qt 5 在 OLE 枚举格式（即放入剪贴板时）就会读取位图以判断是否有透明通道，
+//   推迟解码只会让它落在GUI线程上，因此仍由 ReceivePipeline 在工作线程中解码
+// 持有落盘的原图文件，随剪贴板内容一起删除（被替换时；程序退出时 Qt 先把所有格式写入系统剪贴板）
+class DeferredMimeData : public QMimeData
+{
+    Q_OBJECT
+
+public:
+    explicit DeferredMimeData(const ReceivedImage& image);
+    ~DeferredMimeData();
+
+    QStringList formats(void) const override;
+    bool hasFormat(const QString& mimeType) const override;
+
+    static const QString JFIF_MIME; // Windows 程序约定的 JPEG 剪贴板格式名
+
+protected:
+    QVariant retrieveData(const QString& mimeType, QVariant::Type type) const override;
+
+private:
+    QByteArray encodedBytes(void) const;
+
+private:
+    ReceivedImage source;
+    QStringList announced;
+};
+
+#endif // DEFERREDMIMEDATA_H
@@ -0,0 +1,154 @@
+#include "deltasync.h"
+#include "util.h"
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QtEndian>
+#include <QDebug>
+
+bool DeltaSync::makeDelta(const QString& channel, const ClipPayload& full, ClipPayload* delta) const
+{
+    if (!full.isText || full.data.size() < MIN_SIZE) return false;
+    auto it = acked.constFind(channel);
+    if (it == acked.constEnd()) return false;
+
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray ops = encode(it->data, full.data);
+    const qint64 costMs = timer.elapsed();
+    if (ops.size() * 2 > full.data.size()) { // 改动太大，不如完整发送
+        qDebug() << "Delta not worth it:" << Util::printDataSize(ops.size()) << "of" << Util::printDataSize(full.data.size());
+        return false;
+    }
+
+    qDebug() << "Delta:" << Util::printDataSize(ops.size()) << "instead of" << Util::printDataSize(full.data.size())
+             << QString("(saved %1%)").arg(100 - ops.size() * 100 / full.data.size()) << costMs << "ms";
+    *delta = full;
+    delta->data = ops;
+    delta->deltaBase = QString::fromLatin1(it->id);
+    return true;
+}
+
+void DeltaSync::acknowledge(const QString& channel, const ClipPayload& full, const QByteArray& serverBase)
+{
+    if (!full.isText || serverBase.isEmpty()) {
+        forget(channel);
+        return;
+    }
+    const QByteArray id = baseId(full.data);
+    if (serverBase != id) {
+        forget(channel);
+        return;
+    }
+    acked.insert(channel, {full.data, id});
+}
+
+QByteArray DeltaSync::baseId(const QByteArray& data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex();
+}
+
+static void appendCopy(QByteArray& out, quint32 offset, quint32 length)
+{
+    uchar op[9] = {'C'};
+    qToBigEndian<quint32>(offset, op + 1);
+    qToBigEndian<quint32>(length, op + 5);
+    out.append(reinterpret_cast<const char*>(op), sizeof(op));
+}
+
+static void appendInsert(QByteArray& out, const char* data, quint32 length)
+{
+    uchar op[5] = {'I'};
+    qToBigEndian<quint32>(length, op + 1);
+    out.append(reinterpret_cast<const char*>(op), sizeof(op));
+    out.append(data, int(length));
+}
+
+QByteArray DeltaSync::encode(const QByteArray& base, const QByteArray& target)
+{
+    // 基准按行切分，记录每行的起始位置；行内容 -> 行号（fromRawData 不拷贝）
+    QVector<int> lineStarts;
+    QHash<QByteArray, int> lineIndex;
+    for (int pos = 0; pos < base.size();) {
+        int end = base.indexOf('\n', pos);
+        end = end == -1 ? base.size() : end + 1;
+        lineIndex.insert(QByteArray::fromRawData(base.constData() + pos, end - pos), lineStarts.size());
+        lineStarts << pos;
+        pos = end;
+    }
+    lineStarts << base.size(); // 哨兵，方便计算最后一行的结尾
+
+    QByteArray out;
+    qint64 copyOffset = -1, copyLength = 0; // 当前合并中的复制段
+    int nextBaseLine = -1;                  // 期望的下一基准行，用于延续复制段
+    int literalStart = -1;                  // 当前合并中的插入段（target 中的起点）
+
+    auto flushCopy = [&]() {
+        if (copyLength > 0) appendCopy(out, quint32(copyOffset), quint32(copyLength));
+        copyLength = 0;
+    };
+    auto flushLiteral = [&](int end) {
+        if (literalStart >= 0) appendInsert(out, target.constData() + literalStart, quint32(end - literalStart));
+        literalStart = -1;
+    };
+
+    for (int pos = 0; pos < target.size();) {
+        int end = target.indexOf('\n', pos);
+        end = end == -1 ? target.size() : end + 1;
+        const QByteArray line = QByteArray::fromRawData(target.constData() + pos, end - pos);
+
+        int baseLine = -1;
+        if (nextBaseLine >= 0 && nextBaseLine < lineStarts.size() - 1
+            && lineStarts[nextBaseLine + 1] - lineStarts[nextBaseLine] == line.size()
+            && memcmp(base.constData() + lineStarts[nextBaseLine], line.constData(), size_t(line.size())) == 0) {
+            baseLine = nextBaseLine; // 优先延续上一段，保持复制段连续
+        } else {
+            baseLine = lineIndex.value(line, -1);
+        }
+
+        if (baseLine >= 0) {
+            flushLiteral(pos);
+            const qint64 offset = lineStarts[baseLine];
+            if (copyLength > 0 && copyOffset + copyLength == offset) {
+                copyLength += line.size();
+            } else {
+                flushCopy();
+                copyOffset = offset;
+                copyLength = line.size();
+            }
+            nextBaseLine = baseLine + 1;
+        } else {
+            flushCopy();
+            if (literalStart < 0) literalStart = pos;
+            nextBaseLine = -1;
+        }
+        pos = end;
+    }
+    flushCopy();
+    flushLiteral(target.size());
+    return out;
+}
+
+bool DeltaSync::apply(const QByteArray& base, const QByteArray& delta, QByteArray* out)
+{
+    out->clear();
+    const uchar* p = reinterpret_cast<const uchar*>(delta.constData());
+    const uchar* end = p + delta.size();
+    while (p < end) {
+        if (*p == 'C' && end - p >= 9) {
+            const quint32 offset = qFromBigEndian<quint32>(p + 1);
+            const quint32 length = qFromBigEndian<quint32>(p + 5);
+            if (quint64(offset) + length > quint64(base.size())) return false;
+            out->append(base.constData() + offset, int(length));
+            p += 9;
+        } else if (*p == 'I' && end - p >= 5) {
+            const quint32 length = qFromBigEndian<quint32>(p + 1);
+            if (quint64(end - p - 5) < length) return false;
+            out->append(reinterpret_cast<const char*>(p + 5), int(length));
+            p += 5 + length;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef DELTASYNC_H
+#define DELTASYNC_H
+
+#include <QHash>
+#include <QByteArray>
+#include <QString>
+#include "wireformat.h"
+
+// 大文本增量同步：修改一大段文本后再次复制，只上传与“服务端已确认的上一版”之间的差异
+// - 服务端在 POST 响应头 X-Delta-Base 中返回它保存的文本的 SHA-256，作为下次增量的基准
+// - 服务端不认识基准时返回 412，客户端忘记基准并改为完整发送
+//
+// 增量格式（大端序），由若干操作组成：
+// | 'C' | offset:u32 | length:u32 |       从基准复制一段字节
+// | 'I' | length:u32 | bytes |            插入新字节
+// 按行匹配（文本编辑通常以行为单位），输出按字节偏移，应用时无需再分行
+class DeltaSync {
+public:
+    // 生成增量载荷（仅二进制帧可用）；不适用（无基准 / 太小 / 收益不够）时返回false
+    bool makeDelta(const QString& channel, const ClipPayload& full, ClipPayload* delta) const;
+    // 上传成功：serverBase 与本次数据一致时记为新的基准，否则忘记
+    void acknowledge(const QString& channel, const ClipPayload& full, const QByteArray& serverBase);
+    void forget(const QString& channel) { acked.remove(channel); }
+
+    static QByteArray encode(const QByteArray& base, const QByteArray& target);
+    static bool apply(const QByteArray& base, const QByteArray& delta, QByteArray* out);
+    static QByteArray baseId(const QByteArray& data);
+
+    static constexpr int MIN_SIZE = 4 * 1024; // 小文本直接完整发送
+
+private:
+    struct Base {
+        QByteArray data;
+        QByteArray id;
+    };
+    QHash<QString, Base> acked; // 每个频道服务端已确认的上一版文本
+};
+
+#endif // DELTASYNC_H
@@ -0,0 +1,53 @@
+#include "encodecache.h"
+
+bool EncodeCache::lookup(quint64 fingerprint, Entry* entry)
+{
+    QMutexLocker locker(&mutex);
+    for (int i = 0; i < entries.size(); i++) {
+        if (entries[i].first != fingerprint) continue;
+        entries.move(i, 0);
+        *entry = entries.first().second;
+        hits++;
+        return true;
+    }
+    return false;
+}
+
+void EncodeCache::insert(quint64 fingerprint, const Entry& entry)
+{
+    QMutexLocker locker(&mutex);
+    for (int i = 0; i < entries.size(); i++) {
+        if (entries[i].first == fingerprint) {
+            entries.removeAt(i);
+            break;
+        }
+    }
+    entries.prepend(qMakePair(fingerprint, entry));
+
+    qint64 total = 0;
+    for (int i = 0; i < entries.size(); i++) {
+        total += entries[i].second.data.size() + entries[i].second.wire.size();
+        if (i > 0 && (i >= capacity || total > maxBytes)) { // 至少保留刚插入的一条
+            entries.erase(entries.begin() + i, entries.end());
+            break;
+        }
+    }
+}
+
+void EncodeCache::markUploaded(quint64 fingerprint)
+{
+    QMutexLocker locker(&mutex);
+    uploaded = fingerprint;
+}
+
+void EncodeCache::clearUploaded()
+{
+    QMutexLocker locker(&mutex);
+    uploaded = 0;
+}
+
+bool EncodeCache::isUploaded(quint64 fingerprint)
+{
+    QMutexLocker locker(&mutex);
+    return fingerprint != 0 && fingerprint == uploaded;
+}
@@ -0,0 +1,43 @@
+#ifndef ENCODECACHE_H
+#define ENCODECACHE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QMutex>
+
+// 编码结果缓存：原始内容指纹 → 已编码的数据（及预编码的请求体）
+// 同一张截图复制两次、剪贴板管理器重新声明所有权时，只需哈希一次，不再重新编码
+// 同时记录服务端已确认的最近一次上传：内容相同则无需再传（服务端的最新值就是它）
+// LRU，按条数和总字节数淘汰；工作线程与GUI线程都会访问，加锁
+class EncodeCache {
+public:
+    struct Entry {
+        QByteArray data;
+        QByteArray wire;    // 预编码的请求体，与 wireKey 一致时可直接使用
+        QByteArray wireKey;
+        QString reduction;
+    };
+
+    explicit EncodeCache(int capacity = 8, qint64 maxBytes = 32 * 1024 * 1024) : capacity(capacity), maxBytes(maxBytes) {}
+
+    bool lookup(quint64 fingerprint, Entry* entry);
+    void insert(quint64 fingerprint, const Entry& entry);
+
+    // 服务端已确认保存的最新内容；收到其他设备的数据后，服务端的最新值已变，需要清除
+    void markUploaded(quint64 fingerprint);
+    void clearUploaded(void);
+    bool isUploaded(quint64 fingerprint);
+
+    quint64 hitCount() const { QMutexLocker locker(&mutex); return hits; } // 工作线程在锁内递增
+
+private:
+    int capacity;
+    qint64 maxBytes;
+    QList<QPair<quint64, Entry>> entries; // 最近使用的在前
+    quint64 uploaded = 0;
+    quint64 hits = 0;
+    mutable QMutex mutex;
+};
+
+#endif // ENCODECACHE_H
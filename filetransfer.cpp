@@ -0,0 +1,333 @@
+#include "filetransfer.h"
+#include <QFileInfo>
+#include <QDir>
+#include <QRegularExpression>
+#include <QThreadPool>
+#include <QPointer>
+#include <QDebug>
+
+QList<ClipFile> FileTransfer::collect(const QList<QUrl>& urls, QString* error)
+{
+    QList<ClipFile> files;
+    for (const QUrl& url : urls) {
+        QString reason;
+        const QFileInfo info(url.toLocalFile());
+        if (!url.isLocalFile())
+            reason = "Not a local file: " + url.toString();
+        else if (info.isDir())
+            reason = "Folders are not supported: " + info.fileName();
+        else if (!info.isFile())
+            reason = "File not found: " + info.filePath();
+        if (!reason.isEmpty()) {
+            if (error) *error = reason;
+            return {};
+        }
+        files << ClipFile {info.fileName(), info.size(), info.absoluteFilePath()};
+    }
+    return files;
+}
+
+qint64 FileTransfer::totalSize(const QList<ClipFile>& files)
+{
+    qint64 total = 0;
+    for (const ClipFile& file : files)
+        total += file.size;
+    return total;
+}
+
+QString FileTransfer::sanitizeName(const QString& name)
+{
+    static const QRegularExpression illegal(R"([<>:"/\\|?*\x00-\x1F])");
+    static const QRegularExpression reserved(R"(^(CON|PRN|AUX|NUL|COM\d|LPT\d)(\..*)?$)", QRegularExpression::CaseInsensitiveOption);
+    QString safe = name.mid(qMax(name.lastIndexOf('/'), name.lastIndexOf('\\')) + 1); // 只保留文件名，防止 ..\ 跳出下载目录
+    safe.replace(illegal, "_");
+    while (safe.endsWith('.') || safe.endsWith(' ')) // Windows 会静默去掉结尾的点和空格
+        safe.chop(1);
+    safe = safe.trimmed();
+    if (safe.isEmpty()) return "file";
+    if (reserved.match(safe).hasMatch()) safe.prepend('_'); // 设备名
+    return safe;
+}
+
+QString FileTransfer::uniquePath(const QString& dir, const QString& name)
+{
+    const QDir target(dir);
+    QString path = target.filePath(name);
+    const QFileInfo info(name);
+    const QString base = info.completeBaseName();
+    const QString suffix = info.suffix().isEmpty() ? QString() : "." + info.suffix();
+    for (int i = 1; QFileInfo::exists(path); i++)
+        path = target.filePath(QString("%1 (%2)%3").arg(base).arg(i).arg(suffix));
+    return path;
+}
+
+FileUploadDevice::FileUploadDevice(const QByteArray& header, const QList<ClipFile>& files, QObject* parent)
+    : QIODevice(parent)
+    , header(header)
+    , files(files)
+{
+    total = header.size();
+    for (const ClipFile& file : files) {
+        offsets << total;
+        total += file.size;
+    }
+}
+
+FileUploadDevice::~FileUploadDevice()
+{
+    unmapFile();
+}
+
+bool FileUploadDevice::open(OpenMode mode)
+{
+    if (mode & WriteOnly) return false;
+    for (const ClipFile& file : files) { // 复制之后文件被修改，元数据中的大小已经不对
+        const QFileInfo info(file.path);
+        if (!info.isFile() || info.size() != file.size) {
+            setErrorString("File changed or removed since copied: " + file.name);
+            return false;
+        }
+    }
+    // 不使用 QIODevice 的内部缓冲：数据已经在映射的内存中，再拷贝一次没有意义，也让 pos() 与实际读取位置一致
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void FileUploadDevice::close()
+{
+    unmapFile();
+    QIODevice::close();
+}
+
+bool FileUploadDevice::seek(qint64 pos)
+{
+    if (pos < 0 || pos > total) return false;
+    return QIODevice::seek(pos);
+}
+
+qint64 FileUploadDevice::readData(char* data, qint64 maxSize)
+{
+    qint64 cursor = pos();
+    qint64 done = 0;
+    while (done < maxSize && cursor < total) {
+        qint64 n = 0;
+        if (cursor < header.size()) {
+            n = qMin(maxSize - done, header.size() - cursor);
+            memcpy(data + done, header.constData() + cursor, size_t(n));
+        } else {
+            int index = current;
+            if (index < 0 || cursor < offsets[index] || cursor >= offsets[index] + files[index].size) {
+                index = 0; // 空文件不占位置，自然会被跳过
+                while (!(cursor >= offsets[index] && cursor < offsets[index] + files[index].size))
+                    index++;
+                if (!mapFile(index)) return done > 0 ? done : -1;
+            }
+            const qint64 offset = cursor - offsets[index];
+            n = qMin(maxSize - done, files[index].size - offset);
+            if (mapped) {
+                memcpy(data + done, mapped + offset, size_t(n));
+            } else { // 映射失败（或文件过大）时退回普通读取
+                if (!file.seek(offset) || (n = file.read(data + done, n)) <= 0) {
+                    setErrorString(file.errorString());
+                    return done > 0 ? done : -1;
+                }
+            }
+        }
+        done += n;
+        cursor += n;
+    }
+    return done;
+}
+
+bool FileUploadDevice::mapFile(int index)
+{
+    unmapFile();
+    file.setFileName(files[index].path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() != files[index].size) {
+        qCritical() << "Unable to read the file:" << files[index].path << file.errorString();
+        setErrorString("Unable to read the file: " + files[index].name);
+        file.close();
+        return false;
+    }
+    if (file.size() <= MAX_MAP)
+        mapped = file.map(0, file.size());
+    if (!mapped)
+        qDebug() << "File not mapped, read in chunks:" << files[index].name;
+    current = index;
+    return true;
+}
+
+void FileUploadDevice::unmapFile()
+{
+    if (mapped) file.unmap(mapped);
+    mapped = nullptr;
+    file.close();
+    current = -1;
+}
+
+FileDownloadSink::FileDownloadSink(const QString& dir, const QList<ClipFile>& files)
+    : dir(dir)
+    , files(files)
+{
+    total = FileTransfer::totalSize(files);
+    if (!QDir().mkpath(dir))
+        error = "Unable to create the download folder: " + dir;
+}
+
+FileDownloadSink::~FileDownloadSink()
+{
+    if (!done) abort();
+}
+
+bool FileDownloadSink::write(const char* data, qint64 size)
+{
+    if (!error.isEmpty()) return false;
+    if (receivedBytes + size > total) {
+        error = "Received more data than announced.";
+        return false;
+    }
+    while (size > 0) {
+        if (remaining == 0 && !openNext()) return false;
+        const qint64 n = qMin(size, remaining);
+        if (file.write(data, n) != n) {
+            error = file.errorString();
+            return false;
+        }
+        data += n;
+        size -= n;
+        remaining -= n;
+        receivedBytes += n;
+    }
+    return true;
+}
+
+bool FileDownloadSink::finish(QStringList* paths)
+{
+    if (error.isEmpty() && receivedBytes != total)
+        error = QString("Incomplete download: %1 / %2 bytes.").arg(receivedBytes).arg(total);
+    if (error.isEmpty() && remaining == 0)
+        openNext(); // 末尾的空文件
+    file.close();
+    if (!error.isEmpty()) {
+        abort();
+        return false;
+    }
+    // 收齐后才改名，下载目录里不会出现半个文件；最终文件名此时才确定，不覆盖期间出现的同名文件
+    for (int i = 0; i < partPaths.size(); i++) {
+        const QString path = FileTransfer::uniquePath(dir, FileTransfer::sanitizeName(files[i].name));
+        if (!QFile::rename(partPaths[i], path)) {
+            error = "Unable to rename " + partPaths[i];
+            partPaths = partPaths.mid(i); // 已改名的是完整文件，保留
+            abort();
+            return false;
+        }
+        partPaths[i] = path;
+    }
+    if (paths) *paths = partPaths;
+    done = true;
+    return true;
+}
+
+void FileDownloadSink::abort()
+{
+    file.close();
+    for (const QString& path : qAsConst(partPaths))
+        QFile::remove(path);
+    partPaths.clear();
+    done = true;
+}
+
+bool FileDownloadSink::openNext()
+{
+    file.close();
+    while (++current < files.size()) {
+        const QString path = FileTransfer::uniquePath(dir, FileTransfer::sanitizeName(files[current].name) + ".part");
+        file.setFileName(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            error = file.errorString();
+            return false;
+        }
+        partPaths << path;
+        remaining = files[current].size;
+        if (remaining > 0) return true;
+        file.close(); // 空文件，创建即可
+    }
+    return false;
+}
+
+static QThreadPool* downloadIoPool()
+{
+    static QThreadPool* pool = [] {
+        auto p = new QThreadPool;
+        p->setMaxThreadCount(1); // 串行：同一文件的数据块按顺序写入
+        return p;
+    }();
+    return pool;
+}
+
+FileDownloadJob::FileDownloadJob(QNetworkReply* reply, const QString& dir, const QList<ClipFile>& files, QObject* parent)
+    : QObject(parent)
+    , reply(reply)
+    , sink(QSharedPointer<FileDownloadSink>::create(dir, files))
+{
+    reply->setParent(this);
+    reply->setReadBufferSize(READ_BUFFER);
+    connect(reply, &QNetworkReply::readyRead, this, &FileDownloadJob::drain);
+    connect(reply, &QNetworkReply::finished, this, [=]() {
+        replyDone = true;
+        if (reply->error() != QNetworkReply::NoError && error.isEmpty())
+            error = reply->errorString();
+        drain(); // 读出剩余数据
+        finishIfDone();
+    });
+}
+
+void FileDownloadJob::drain()
+{
+    QPointer<FileDownloadJob> self(this);
+    while (error.isEmpty() && inFlight < MAX_IN_FLIGHT && reply->bytesAvailable() > 0) {
+        const QByteArray chunk = reply->read(READ_BUFFER);
+        inFlight += chunk.size();
+        const QSharedPointer<FileDownloadSink> target = sink;
+        downloadIoPool()->start([=]() {
+            const bool ok = target->write(chunk.constData(), chunk.size());
+            QMetaObject::invokeMethod(self, [=]() { // 回到GUI线程
+                if (self) self->onWritten(chunk.size(), ok);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void FileDownloadJob::onWritten(qint64 size, bool ok)
+{
+    inFlight -= size;
+    if (!ok) fail(sink->errorString()); // 写入失败的任务之后，I/O 线程不会再修改 error
+    drain(); // 写盘跟上了，继续读取已缓冲的数据（readyRead 不会为它们再次触发）
+    finishIfDone();
+}
+
+void FileDownloadJob::fail(const QString& message)
+{
+    if (!error.isEmpty()) return;
+    error = message;
+    if (!replyDone) reply->abort(); // 同步触发 finished
+}
+
+void FileDownloadJob::finishIfDone()
+{
+    if (completed || !replyDone || inFlight > 0) return; // 等已取出的数据写完
+    completed = true;
+    QPointer<FileDownloadJob> self(this);
+    const QSharedPointer<FileDownloadSink> target = sink;
+    const QString failure = error;
+    downloadIoPool()->start([=]() { // 改名、删除 .part 也是磁盘操作
+        QStringList paths;
+        const bool ok = failure.isEmpty() && target->finish(&paths);
+        if (!failure.isEmpty()) target->abort();
+        const QString message = failure.isEmpty() ? target->errorString() : failure;
+        QMetaObject::invokeMethod(self, [=]() {
+            if (!self) return;
+            emit self->finished(ok, paths, message);
+            self->deleteLater();
+        }, Qt::QueuedConnection);
+    });
+}
@@ -0,0 +1,128 @@
+#ifndef FILETRANSFER_H
+#define FILETRANSFER_H
+
+#include <QIODevice>
+#include <QFile>
+#include <QList>
+#include <QUrl>
+#include <QNetworkReply>
+#include <QSharedPointer>
+#include "wireformat.h"
+
+// 文件传输：复制的文件（text/uri-list）不读入内存
+// - 上传：FileUploadDevice 依次映射各文件，QNetworkAccessManager 按块读取，直接写入请求体
+// - 下载：FileDownloadSink 把响应流按元数据中的大小切分，边收边写入下载目录；FileDownloadJob 让写盘在 I/O 线程中进行
+// 文件内容不走 WireFormat 的 2MB 上限，也不经过局域网直连 / 离线发件箱 / 端到端加密，大小上限可配置
+class FileTransfer {
+private:
+    FileTransfer() = delete;
+
+public:
+    // 只接受本地文件；目录、不存在的文件、非本地URL返回空，并给出原因
+    static QList<ClipFile> collect(const QList<QUrl>& urls, QString* error = nullptr);
+    static qint64 totalSize(const QList<ClipFile>& files);
+    // 去掉路径和 Windows 文件名中的非法字符；下载的文件名来自其他设备，不可信
+    static QString sanitizeName(const QString& name);
+    // dir 下不存在的文件名：a.txt → a (1).txt
+    static QString uniquePath(const QString& dir, const QString& name);
+};
+
+// 请求体：header（WireFormat::encodeFileListHeader）+ 各文件内容依次拼接
+// 非顺序设备，size() 已知，QNetworkAccessManager 会设置 Content-Length 并按块读取，重定向 / 重试时可 seek 回头
+// 同一时刻只映射一个文件，32位进程也不会耗尽地址空间（超过映射上限的单个文件改为普通读取）
+class FileUploadDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    FileUploadDevice(const QByteArray& header, const QList<ClipFile>& files, QObject* parent = nullptr);
+    ~FileUploadDevice();
+
+    bool open(OpenMode mode) override; // 文件缺失或大小已变化（复制后被修改）时失败
+    void close(void) override;
+    bool isSequential(void) const override { return false; }
+    qint64 size(void) const override { return total; }
+    bool seek(qint64 pos) override;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char*, qint64) override { return -1; }
+
+private:
+    bool mapFile(int index);
+    void unmapFile(void);
+
+private:
+    QByteArray header;
+    QList<ClipFile> files;
+    QList<qint64> offsets; // 各文件在请求体中的起始位置
+    qint64 total = 0;
+    int current = -1; // 当前打开的文件
+    QFile file;
+    uchar* mapped = nullptr;
+
+    static constexpr qint64 MAX_MAP = 256LL * 1024 * 1024;
+};
+
+// 接收端：按文件列表的大小顺序切分数据流，先写入 .part，全部收完后再改名，不覆盖已有文件
+class FileDownloadSink {
+public:
+    FileDownloadSink(const QString& dir, const QList<ClipFile>& files);
+    ~FileDownloadSink(); // 未 finish() 时删除未完成的文件
+
+    bool write(const char* data, qint64 size); // 超出声明的总大小 / 写入失败时返回 false
+    bool finish(QStringList* paths); // 收齐后改名为最终文件名
+    void abort(void);
+
+    qint64 received(void) const { return receivedBytes; }
+    qint64 expected(void) const { return total; }
+    QString errorString(void) const { return error; }
+
+private:
+    bool openNext(void); // 跳过（并创建）空文件
+
+private:
+    QString dir;
+    QList<ClipFile> files;
+    QStringList partPaths;
+    int current = -1;
+    qint64 remaining = 0; // 当前文件还剩多少字节
+    qint64 receivedBytes = 0;
+    qint64 total = 0;
+    QFile file;
+    QString error;
+    bool done = false;
+};
+
+// 下载任务：GUI线程只从 reply 中取出数据，写盘（FileDownloadSink）在单线程的 I/O 线程池中串行进行，磁盘慢不会卡住托盘
+// 反压：已取出、尚未写盘的数据超过 MAX_IN_FLIGHT 时暂停读取，reply 的读缓冲（READ_BUFFER）满后 TCP 窗口随之收紧
+// 完成（或失败）后发出 finished 并自行销毁，reply 也随之释放
+class FileDownloadJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    FileDownloadJob(QNetworkReply* reply, const QString& dir, const QList<ClipFile>& files, QObject* parent = nullptr);
+
+signals:
+    void finished(bool ok, const QStringList& paths, const QString& error);
+
+private:
+    void drain(void); // 在途数据未超限时继续读取
+    void onWritten(qint64 size, bool ok);
+    void finishIfDone(void);
+    void fail(const QString& message);
+
+private:
+    QNetworkReply* reply;
+    QSharedPointer<FileDownloadSink> sink; // I/O 线程的任务也持有，任务晚于本对象结束时不会访问已释放的内存
+    qint64 inFlight = 0;
+    bool replyDone = false;
+    bool completed = false;
+    QString error;
+
+    static constexpr qint64 READ_BUFFER = 256 * 1024;
+    static constexpr qint64 MAX_IN_FLIGHT = 1024 * 1024;
+};
+
+#endif // FILETRANSFER_H
@@ -0,0 +1,232 @@
+#include "imagecodec.h"
+#include "jpegstripencoder.h"
+#include <QImageWriter>
+#include <QBuffer>
+#include <QPainter>
+#include <QSet>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cmath>
+
+static constexpr int SHARP_DELTA = 64;      // 相邻像素任一通道差值 ≥ 64 视为突变
+static constexpr double SCREENSHOT_FLAT = 0.4;
+static constexpr double SCREENSHOT_SMOOTH = 0.3;
+static constexpr int JPEG_QUALITY = 85;
+static constexpr int SCALED_QUALITY = 70;
+static constexpr int MAX_SCALE_STEPS = 6;
+static constexpr int MIN_SCALED_SIDE = 240;   // 再小就没有意义了，交给调用方拒绝
+
+ImageCodec::Traits ImageCodec::classify(const QImage& image)
+{
+    Traits traits;
+    if (image.isNull()) return traits;
+
+    const int w = image.width(), h = image.height();
+    const int step = qMax(1, int(std::sqrt(double(w) * h / SAMPLE_PIXELS))); // 网格抽样，大图也只看约6.5万个点
+    const bool alphaChannel = image.hasAlphaChannel();
+    QSet<QRgb> colors;
+    qint64 flat = 0, sharp = 0, smooth = 0;
+    for (int y = 0; y < h; y += step) {
+        for (int x = 0; x + 1 < w; x += step) {
+            const QRgb a = image.pixel(x, y), b = image.pixel(x + 1, y); // 与右侧紧邻像素比较，而不是下一个抽样点
+            if (colors.size() <= MAX_TRACKED_COLORS) colors.insert(a);
+            if (alphaChannel && qAlpha(a) < 255) traits.hasAlpha = true;
+            const int d = qMax(qMax(qAbs(qRed(a) - qRed(b)), qAbs(qGreen(a) - qGreen(b))), qAbs(qBlue(a) - qBlue(b)));
+            if (d == 0) flat++;
+            else if (d >= SHARP_DELTA) sharp++;
+            else smooth++;
+        }
+    }
+    const qint64 pairs = flat + sharp + smooth;
+    if (pairs == 0) return traits; // 宽度为1之类的退化图像，jpg 即可
+
+    traits.colors = colors.size();
+    traits.flat = double(flat) / pairs;
+    traits.sharp = double(sharp) / pairs;
+    traits.smooth = double(smooth) / pairs;
+    if (traits.colors <= 256)
+        traits.kind = Graphic;
+    else if (traits.flat >= SCREENSHOT_FLAT && traits.smooth < SCREENSHOT_SMOOTH)
+        traits.kind = Screenshot;
+    else
+        traits.kind = Photo;
+    return traits;
+}
+
+ImageCodec::Result ImageCodec::encode(const QImage& image, const Budget& budget)
+{
+    QElapsedTimer timer;
+    timer.start();
+    Result result;
+    result.traits = classify(image);
+    const Traits& t = result.traits;
+
+    bool losslessTooLarge = false;
+    QList<QByteArray> lossless;
+    if (t.kind == Graphic && fitsPalette(image))
+        lossless << "png8";
+    else if (t.kind != Photo || t.hasAlpha) { // 带透明通道的照片也先试无损，jpg 会丢失透明度
+        if (hasWebP()) lossless << "webp"; // 截图通常比 PNG 小 20%~40%，但编码更慢，预计超时则退回 PNG
+        lossless << "png";
+    }
+
+    for (const QByteArray& format : lossless) {
+        const qint64 remaining = budget.maxEncodeMs - timer.elapsed();
+        if (predictMs(format, image) > remaining) {
+            qDebug() << "Info: Skip" << format << "(predicted over time budget)";
+            continue;
+        }
+        QElapsedTimer encodeTimer;
+        encodeTimer.start();
+        const QByteArray data = encodeAs(image, format, format == "webp" ? 100 : -1); // qwebp: quality 100 即无损
+        recordMs(format, image, encodeTimer.elapsed());
+        if (!data.isEmpty() && data.size() <= budget.maxBytes) {
+            result.data = data;
+            result.format = format == "png8" ? "png" : format;
+            result.indexed = format == "png8";
+        } else {
+            losslessTooLarge = !data.isEmpty();
+        }
+        break; // 只编码一种无损格式：WebP 都放不下，PNG 更放不下
+    }
+
+    if (result.data.isEmpty()) { // 照片，或无损超出预算：jpg，超出字节预算时逐级降低质量
+        const QImage rgb = opaque(image); // 只转换一次，逐级重试时复用
+        // 并行编码与 QImageWriter 速度相差数倍，分开统计，否则交替出现时两者的预测都不准
+        const QByteArray speedKey = JpegStripEncoder::worthIt(rgb) ? "jpg-strips" : "jpg";
+        static const int qualities[] = {JPEG_QUALITY, 70, 50};
+        for (int quality : qualities) {
+            QElapsedTimer encodeTimer;
+            encodeTimer.start();
+            result.data = encodeAs(rgb, "jpg", quality);
+            result.quality = quality;
+            recordMs(speedKey, image, encodeTimer.elapsed());
+            if (result.data.size() <= budget.maxBytes || timer.elapsed() + predictMs(speedKey, image) > budget.maxEncodeMs)
+                break; // 放得下，或没有时间再试
+        }
+        result.format = "jpg";
+
+        // 降低质量仍放不下（如高DPI截图）：逐步缩小分辨率，体积大致与像素数成正比；不受时间预算限制，总比丢弃好
+        QImage scaled = rgb;
+        for (int step = 0; result.data.size() > budget.maxBytes && step < MAX_SCALE_STEPS; step++) {
+            const double factor = qBound(0.3, std::sqrt(double(budget.maxBytes) / result.data.size()) * 0.95, 0.9);
+            const QSize size = scaled.size() * factor;
+            if (qMin(size.width(), size.height()) < MIN_SCALED_SIDE) break;
+            scaled = scaled.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            result.data = encodeAs(scaled, "jpg", SCALED_QUALITY); // 缩小后用中等质量，比原尺寸的低质量更清晰
+            result.quality = SCALED_QUALITY;
+            result.scaledSize = scaled.size();
+        }
+
+        if (result.scaledSize.isValid())
+            result.reduction = QString("%1×%2 → %3×%4, jpg q%5").arg(image.width()).arg(image.height())
+                               .arg(result.scaledSize.width()).arg(result.scaledSize.height()).arg(result.quality);
+        else if (losslessTooLarge || result.quality < JPEG_QUALITY)
+            result.reduction = QString("jpg q%1").arg(result.quality);
+    }
+    result.encodeMs = timer.elapsed();
+
+    qDebug().noquote() << QString("Image codec: %1 → %2%3, %4 KB in %5 ms (colors %6%7, flat %8, sharp %9, smooth %10)%11")
+                          .arg(kindName(t.kind)).arg(QString(result.format))
+                          .arg(result.quality >= 0 ? QString(" q%1").arg(result.quality) : QString())
+                          .arg(result.data.size() / 1024).arg(result.encodeMs)
+                          .arg(t.colors).arg(t.colors > MAX_TRACKED_COLORS ? "+" : "")
+                          .arg(t.flat, 0, 'f', 2).arg(t.sharp, 0, 'f', 2).arg(t.smooth, 0, 'f', 2)
+                          .arg(result.reduction.isEmpty() ? QString() : "; reduced: " + result.reduction);
+    return result;
+}
+
+QByteArray ImageCodec::encodeAs(const QImage& image, const QByteArray& format, int quality)
+{
+    QImage source = image;
+    if (format == "png8") {
+        source = image.convertToFormat(QImage::Format_Indexed8, Qt::ThresholdDither | Qt::AvoidDither); // ≤256色时为精确调色板
+    } else if (format == "jpg") {
+        source = opaque(image);
+    }
+
+    if (format == "jpg" && JpegStripEncoder::worthIt(source)) // 8K多屏截图：多核并行编码
+        return JpegStripEncoder::encode(source, quality < 0 ? 75 : quality);
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, format == "png8" ? "png" : format);
+    writer.setQuality(quality);
+    if (!writer.write(source)) {
+        qWarning() << "WARN: Unable to encode image as" << format << writer.errorString();
+        data.clear();
+    }
+    return data;
+}
+
+QImage ImageCodec::opaque(const QImage& image)
+{
+    if (image.format() == QImage::Format_RGB888) return image;
+    if (!image.hasAlphaChannel())
+        return image.convertToFormat(QImage::Format_RGB888); // JPEG编码器的原生输入，省去编码器内部逐行转换
+
+    QImage flattened(image.size(), QImage::Format_RGB32); // jpg 不支持透明通道，直接转换透明处会变黑
+    flattened.fill(Qt::white);
+    QPainter painter(&flattened);
+    painter.drawImage(0, 0, image);
+    painter.end();
+    return flattened.convertToFormat(QImage::Format_RGB888);
+}
+
+bool ImageCodec::hasWebP()
+{
+    static const bool supported = QImageWriter::supportedImageFormats().contains("webp");
+    return supported;
+}
+
+const char* ImageCodec::kindName(Kind kind)
+{
+    switch (kind) {
+    case Graphic: return "graphic";
+    case Screenshot: return "screenshot";
+    case Photo: return "photo";
+    }
+    return "?";
+}
+
+bool ImageCodec::fitsPalette(const QImage& image)
+{
+    const QImage argb = image.depth() == 32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+    QSet<QRgb> colors;
+    for (int y = 0; y < argb.height(); y++) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+        QRgb last = line[0];
+        colors.insert(last);
+        for (int x = 1; x < argb.width(); x++) {
+            if (line[x] == last) continue; // 图形大多是连续的纯色块，跳过重复查表
+            last = line[x];
+            colors.insert(last);
+            if (colors.size() > 256) return false;
+        }
+    }
+    return colors.size() <= 256;
+}
+
+// 每种格式的编码速度（ns/像素）随机器与内容而变，用实际耗时的滑动平均来预测
+static QMutex speedMutex;
+static QHash<QByteArray, double> nsPerPixel {
+    {"png8", 15}, {"png", 30}, {"webp", 120}, {"jpg", 12}, {"jpg-strips", 12}, // 初始值：4K截图 png 约250ms；并行 jpg 按不快于单核估计
+};
+
+qint64 ImageCodec::predictMs(const QByteArray& format, const QImage& image)
+{
+    QMutexLocker locker(&speedMutex);
+    return qint64(nsPerPixel.value(format, 30) * image.width() * image.height() / 1e6);
+}
+
+void ImageCodec::recordMs(const QByteArray& format, const QImage& image, qint64 ms)
+{
+    const double pixels = double(image.width()) * image.height();
+    if (pixels < 1e5) return; // 小图耗时以固定开销为主，不代表速度
+    QMutexLocker locker(&speedMutex);
+    double& speed = nsPerPixel[format];
+    speed = speed * 0.7 + ms * 1e6 / pixels * 0.3;
+}
@@ -0,0 +1,64 @@
+#ifndef IMAGECODEC_H
+#define IMAGECODEC_H
+
+#include <QImage>
+#include <QByteArray>
+#include <QString>
+
+// 按内容选择图像编码：一律 jpg 会让文字截图发糊，而且常常比 PNG 还大
+// - 图形（≤256色，如图标、图表）：调色板 PNG，无损且最小
+// - 截图（大片纯色 + 锐利边缘，如文字、UI）：无损 WebP（有插件时）或 PNG
+// - 照片（渐变为主）：JPEG
+// 分类只抽样（约6.5万像素），耗时在毫秒级；无损结果超出字节预算、或预计编码超时，则退回 JPEG
+// JPEG 仍超出字节预算时先降低质量，再逐步缩小分辨率，而不是整张丢弃
+// 接收端用 QImage::fromData 按魔数识别格式，无需额外元数据
+class ImageCodec {
+private:
+    ImageCodec() = delete;
+
+public:
+    enum Kind { Graphic, Screenshot, Photo };
+
+    struct Traits {
+        Kind kind = Photo;
+        int colors = 0;        // 抽样得到的颜色数（超过 MAX_TRACKED_COLORS 后不再统计）
+        double flat = 0;       // 相邻像素完全相同的比例
+        double sharp = 0;      // 相邻像素突变（文字、边框）的比例
+        double smooth = 0;     // 相邻像素渐变（照片、阴影）的比例
+        bool hasAlpha = false;
+    };
+
+    struct Budget {
+        int maxBytes = 2 * 1024 * 1024; // 调用方按请求体上限 & 上行带宽确定
+        int maxEncodeMs = 600; // 在线程池中编码，不阻塞GUI，但仍影响送达延迟
+    };
+
+    struct Result {
+        QByteArray data;
+        QByteArray format; // "png" / "webp" / "jpg"，与 QImageWriter 一致
+        int quality = -1;
+        bool indexed = false; // png 调色板模式
+        QSize scaledSize;     // 超出字节预算时缩小后的尺寸，未缩小为无效值
+        QString reduction;    // 非空表示发送的是降质 / 缩小的版本（用于提示用户），如 "3840×2160 → 2880×1620, jpg q70"
+        qint64 encodeMs = 0;
+        Traits traits;
+    };
+
+    static Traits classify(const QImage& image);
+    static Result encode(const QImage& image, const Budget& budget = Budget());
+    // 指定格式编码，不做选择（也供 tools/codecbench 对比）；png 调色板模式用 format "png8"
+    static QByteArray encodeAs(const QImage& image, const QByteArray& format, int quality = -1);
+    static bool hasWebP(void); // 需要 Qt Image Formats 中的 qwebp 插件
+    static const char* kindName(Kind kind);
+
+    static constexpr int MAX_TRACKED_COLORS = 4096;
+    static constexpr int SAMPLE_PIXELS = 65536;
+
+private:
+    static QImage opaque(const QImage& image); // 转为 RGB888，透明处铺白底
+    static bool fitsPalette(const QImage& image); // 全图颜色数 ≤ 256（抽样可能漏掉少量颜色）
+    static qint64 predictMs(const QByteArray& format, const QImage& image);
+    static void recordMs(const QByteArray& format, const QImage& image, qint64 ms);
+};
+
+#endif // IMAGECODEC_H
@@ -0,0 +1,436 @@
+#include "jpegstripencoder.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QVector>
+#include <QtAlgorithms>
+#include <QBuffer>
+#include <QImageWriter>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <functional>
+#include <limits>
+
+namespace {
+
+// 量化表（ITU T.81 Annex K，自然顺序）
+const uchar LUMA_QUANT[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61,   12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56,   14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+};
+const uchar CHROMA_QUANT[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// zigzag 序号 → 自然顺序下标
+const uchar NATURAL_ORDER[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// 标准 Huffman 表（Annex K.3）：长度为 1~16 的码字个数 + 符号
+const uchar DC_LUMA_BITS[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+const uchar DC_CHROMA_BITS[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+const uchar DC_VALUES[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+const uchar AC_LUMA_BITS[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+const uchar AC_LUMA_VALUES[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+const uchar AC_CHROMA_BITS[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+const uchar AC_CHROMA_VALUES[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+struct HuffCode {
+    quint16 code = 0;
+    quint8 length = 0;
+};
+
+struct HuffTable {
+    HuffCode codes[256];
+
+    HuffTable(const uchar* bits, const uchar* values) {
+        int code = 0, k = 0;
+        for (int len = 1; len <= 16; len++) { // 规范 Huffman：同长度码字连续递增
+            for (int i = 0; i < bits[len - 1]; i++) {
+                codes[values[k]].code = quint16(code++);
+                codes[values[k]].length = quint8(len);
+                k++;
+            }
+            code <<= 1;
+        }
+    }
+};
+
+// 编码参数：所有横条共用，只读
+struct Tables {
+    uchar lumaQuant[64];   // 自然顺序，写入 DQT 时转为 zigzag
+    uchar chromaQuant[64];
+    float lumaScale[64];   // 1 / (量化值 * AAN 缩放因子)，把 DCT 的缩放并入量化
+    float chromaScale[64];
+    HuffTable dcLuma {DC_LUMA_BITS, DC_VALUES};
+    HuffTable dcChroma {DC_CHROMA_BITS, DC_VALUES};
+    HuffTable acLuma {AC_LUMA_BITS, AC_LUMA_VALUES};
+    HuffTable acChroma {AC_CHROMA_BITS, AC_CHROMA_VALUES};
+
+    explicit Tables(int quality) {
+        quality = qBound(1, quality, 100);
+        const int scale = quality < 50 ? 5000 / quality : 200 - quality * 2; // 与 libjpeg 的 jpeg_quality_scaling 一致
+        static const float aan[8] = {1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f};
+        for (int k = 0; k < 64; k++) {
+            lumaQuant[k] = uchar(qBound(1, (LUMA_QUANT[k] * scale + 50) / 100, 255));
+            chromaQuant[k] = uchar(qBound(1, (CHROMA_QUANT[k] * scale + 50) / 100, 255));
+            const float f = aan[k / 8] * aan[k % 8] * 8.0f;
+            lumaScale[k] = 1.0f / (lumaQuant[k] * f);
+            chromaScale[k] = 1.0f / (chromaQuant[k] * f);
+        }
+    }
+};
+
+// 熵编码输出：0xFF 之后补 0x00（防止被当作标记）
+// 64位累加器，攒够32位才整体输出，逐字节 append 是热点
+class BitWriter {
+public:
+    explicit BitWriter(QByteArray* out) : out(out) {}
+
+    void write(quint32 code, int length) {
+        buffer = (buffer << length) | (code & ((1u << length) - 1));
+        count += length;
+        if (count >= 32) {
+            count -= 32;
+            const quint32 word = quint32(buffer >> count);
+            if (((~word - 0x01010101u) & word & 0x80808080u) == 0) { // 没有 0xFF 字节（~word 中没有0字节），快速路径
+                const char bytes[4] = {char(word >> 24), char(word >> 16), char(word >> 8), char(word)};
+                out->append(bytes, 4);
+            } else {
+                for (int shift = 24; shift >= 0; shift -= 8) emit(uchar(word >> shift));
+            }
+        }
+    }
+    void write(const HuffCode& code) { write(code.code, code.length); }
+    void flush() { // 用1补齐到字节边界
+        if (count % 8) write(0x7F, 8 - count % 8);
+        while (count > 0) {
+            count -= 8;
+            emit(uchar(buffer >> count));
+        }
+        buffer = 0;
+    }
+
+private:
+    void emit(uchar byte) {
+        out->append(char(byte));
+        if (byte == 0xFF) out->append('\0');
+    }
+
+private:
+    QByteArray* out;
+    quint64 buffer = 0;
+    int count = 0;
+};
+
+// AAN 浮点 DCT（一维），输出带有缩放因子，在量化时统一除掉
+inline void dct8(float* d, int stride)
+{
+    float* p[8];
+    for (int i = 0; i < 8; i++) p[i] = d + i * stride;
+    const float t0 = *p[0] + *p[7], t7 = *p[0] - *p[7];
+    const float t1 = *p[1] + *p[6], t6 = *p[1] - *p[6];
+    const float t2 = *p[2] + *p[5], t5 = *p[2] - *p[5];
+    const float t3 = *p[3] + *p[4], t4 = *p[3] - *p[4];
+
+    // 偶数部分
+    float t10 = t0 + t3, t13 = t0 - t3, t11 = t1 + t2, t12 = t1 - t2;
+    *p[0] = t10 + t11;
+    *p[4] = t10 - t11;
+    const float z1 = (t12 + t13) * 0.707106781f;
+    *p[2] = t13 + z1;
+    *p[6] = t13 - z1;
+
+    // 奇数部分
+    t10 = t4 + t5;
+    t11 = t5 + t6;
+    t12 = t6 + t7;
+    const float z5 = (t10 - t12) * 0.382683433f;
+    const float z2 = t10 * 0.541196100f + z5;
+    const float z4 = t12 * 1.306562965f + z5;
+    const float z3 = t11 * 0.707106781f;
+    const float z11 = t7 + z3, z13 = t7 - z3;
+    *p[5] = z13 + z2;
+    *p[3] = z13 - z2;
+    *p[1] = z11 + z4;
+    *p[7] = z11 - z4;
+}
+
+// 编码一个 8x8 块，返回本块的 DC 值（下一块的预测值）
+int encodeBlock(BitWriter& bits, float* block, const float* scale, int prevDc, const HuffTable& dc, const HuffTable& ac)
+{
+    for (int i = 0; i < 8; i++) dct8(block + i * 8, 1); // 行
+    for (int i = 0; i < 8; i++) dct8(block + i, 8);     // 列
+
+    int coef[64];
+    for (int z = 0; z < 64; z++) {
+        const int k = NATURAL_ORDER[z];
+        const float v = block[k] * scale[k];
+        coef[z] = int(v < 0 ? v - 0.5f : v + 0.5f);
+    }
+
+    // 幅值编码：位数 + 补码形式的低位（负数取反）
+    auto magnitude = [](int v, int* size) {
+        const quint32 a = quint32(v < 0 ? -v : v);
+        *size = a ? 32 - qCountLeadingZeroBits(a) : 0;
+        return quint32(v < 0 ? v - 1 : v);
+    };
+
+    int size = 0;
+    const int diff = coef[0] - prevDc;
+    const quint32 dcBits = magnitude(diff, &size);
+    bits.write(dc.codes[size]);
+    if (size) bits.write(dcBits, size);
+
+    int last = 63;
+    while (last > 0 && coef[last] == 0) last--;
+    int run = 0;
+    for (int z = 1; z <= last; z++) {
+        if (coef[z] == 0) {
+            run++;
+            continue;
+        }
+        while (run >= 16) { // ZRL：16个0
+            bits.write(ac.codes[0xF0]);
+            run -= 16;
+        }
+        const quint32 acBits = magnitude(coef[z], &size);
+        bits.write(ac.codes[(run << 4) | size]);
+        bits.write(acBits, size);
+        run = 0;
+    }
+    if (last != 63) bits.write(ac.codes[0x00]); // EOB
+    return coef[0];
+}
+
+// 编码 MCU 行 [mcuRow0, mcuRow1)：一个独立的重启区间
+void encodeStrip(const QImage& rgb, const Tables& t, int mcuRow0, int mcuRow1, QByteArray* out)
+{
+    const int w = rgb.width(), h = rgb.height();
+    const int mcuCols = (w + 15) / 16;
+    out->reserve(mcuCols * (mcuRow1 - mcuRow0) * 200); // 粗略估计，避免频繁扩容
+    BitWriter bits(out);
+    int dcY = 0, dcCb = 0, dcCr = 0; // 重启区间开始时 DC 预测清零
+
+    float y[4][64], cb[64], cr[64];
+    for (int my = mcuRow0; my < mcuRow1; my++) {
+        const uchar* rows[16];
+        for (int r = 0; r < 16; r++) rows[r] = rgb.constScanLine(qMin(my * 16 + r, h - 1)); // 边缘复制最后一行/列
+        for (int mx = 0; mx < mcuCols; mx++) {
+            int cols[16];
+            for (int c = 0; c < 16; c++) cols[c] = qMin(mx * 16 + c, w - 1) * 3;
+            for (int r = 0; r < 16; r += 2) {
+                for (int c = 0; c < 16; c += 2) {
+                    const uchar* p00 = rows[r] + cols[c];
+                    const uchar* p01 = rows[r] + cols[c + 1];
+                    const uchar* p10 = rows[r + 1] + cols[c];
+                    const uchar* p11 = rows[r + 1] + cols[c + 1];
+                    float* luma = y[(r / 8) * 2 + c / 8] + (r % 8) * 8 + c % 8;
+                    luma[0] = 0.299f * p00[0] + 0.587f * p00[1] + 0.114f * p00[2] - 128.0f;
+                    luma[1] = 0.299f * p01[0] + 0.587f * p01[1] + 0.114f * p01[2] - 128.0f;
+                    luma[8] = 0.299f * p10[0] + 0.587f * p10[1] + 0.114f * p10[2] - 128.0f;
+                    luma[9] = 0.299f * p11[0] + 0.587f * p11[1] + 0.114f * p11[2] - 128.0f;
+                    // 4:2:0 色度下采样：转换是线性的，先对 2x2 的 RGB 取平均再转换，省去3/4的乘法
+                    const float R = (p00[0] + p01[0] + p10[0] + p11[0]) * 0.25f;
+                    const float G = (p00[1] + p01[1] + p10[1] + p11[1]) * 0.25f;
+                    const float B = (p00[2] + p01[2] + p10[2] + p11[2]) * 0.25f;
+                    cb[(r / 2) * 8 + c / 2] = -0.168736f * R - 0.331264f * G + 0.5f * B;
+                    cr[(r / 2) * 8 + c / 2] = 0.5f * R - 0.418688f * G - 0.081312f * B;
+                }
+            }
+            for (int i = 0; i < 4; i++)
+                dcY = encodeBlock(bits, y[i], t.lumaScale, dcY, t.dcLuma, t.acLuma);
+            dcCb = encodeBlock(bits, cb, t.chromaScale, dcCb, t.dcChroma, t.acChroma);
+            dcCr = encodeBlock(bits, cr, t.chromaScale, dcCr, t.dcChroma, t.acChroma);
+        }
+    }
+    bits.flush();
+}
+
+void appendU16(QByteArray* out, int v)
+{
+    out->append(char((v >> 8) & 0xFF));
+    out->append(char(v & 0xFF));
+}
+
+void appendMarker(QByteArray* out, uchar marker)
+{
+    out->append(char(0xFF));
+    out->append(char(marker));
+}
+
+void appendHuffTable(QByteArray* out, int tableClassId, const uchar* bits, const uchar* values)
+{
+    int count = 0;
+    for (int i = 0; i < 16; i++) count += bits[i];
+    appendMarker(out, 0xC4); // DHT
+    appendU16(out, 2 + 1 + 16 + count);
+    out->append(char(tableClassId));
+    out->append(reinterpret_cast<const char*>(bits), 16);
+    out->append(reinterpret_cast<const char*>(values), count);
+}
+
+void appendHeaders(QByteArray* out, const Tables& t, int width, int height, int restartInterval)
+{
+    appendMarker(out, 0xD8); // SOI
+    static const char jfif[] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+    appendMarker(out, 0xE0); // APP0
+    appendU16(out, 2 + int(sizeof(jfif)));
+    out->append(jfif, int(sizeof(jfif)));
+
+    appendMarker(out, 0xDB); // DQT
+    appendU16(out, 2 + 2 * 65);
+    out->append(char(0x00));
+    for (int z = 0; z < 64; z++) out->append(char(t.lumaQuant[NATURAL_ORDER[z]]));
+    out->append(char(0x01));
+    for (int z = 0; z < 64; z++) out->append(char(t.chromaQuant[NATURAL_ORDER[z]]));
+
+    appendMarker(out, 0xC0); // SOF0：基线，Y 2x2 采样，Cb/Cr 1x1
+    appendU16(out, 2 + 6 + 3 * 3);
+    out->append(char(8));
+    appendU16(out, height);
+    appendU16(out, width);
+    out->append(char(3));
+    static const char components[] = {1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1};
+    out->append(components, int(sizeof(components)));
+
+    appendHuffTable(out, 0x00, DC_LUMA_BITS, DC_VALUES);
+    appendHuffTable(out, 0x10, AC_LUMA_BITS, AC_LUMA_VALUES);
+    appendHuffTable(out, 0x01, DC_CHROMA_BITS, DC_VALUES);
+    appendHuffTable(out, 0x11, AC_CHROMA_BITS, AC_CHROMA_VALUES);
+
+    if (restartInterval > 0) {
+        appendMarker(out, 0xDD); // DRI
+        appendU16(out, 4);
+        appendU16(out, restartInterval);
+    }
+
+    appendMarker(out, 0xDA); // SOS
+    appendU16(out, 2 + 1 + 3 * 2 + 3);
+    out->append(char(3));
+    static const char scan[] = {1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+    out->append(scan, int(sizeof(scan)));
+}
+
+QThreadPool* encoderPool()
+{
+    static QThreadPool pool; // 独立于 CapturePipeline 的线程池，避免互相等待
+    return &pool;
+}
+
+} // namespace
+
+bool JpegStripEncoder::worthIt(const QImage& image)
+{
+    if (qint64(image.width()) * image.height() < MIN_PIXELS || QThread::idealThreadCount() < 2) return false;
+    static const double speedup = calibrate(image); // 只测一次，之后的调用直接复用（局部静态变量的初始化是线程安全的）
+    return speedup >= MIN_SPEEDUP;
+}
+
+double JpegStripEncoder::calibrate(const QImage& image)
+{
+    // 取顶部约 200 万像素（整 MCU 行），两边各测两次取最快，排除首次运行时线程创建、缺页的开销；总共约一两百毫秒
+    const int rows = qBound(16, int(2000000 / image.width()) / 16 * 16, image.height());
+    const QImage sample = image.copy(0, 0, image.width(), rows).convertToFormat(QImage::Format_RGB888);
+    auto bestOf2 = [](const std::function<void()>& run) {
+        qint64 best = std::numeric_limits<qint64>::max();
+        for (int round = 0; round < 2; round++) {
+            QElapsedTimer timer;
+            timer.start();
+            run();
+            best = qMin(best, timer.nsecsElapsed());
+        }
+        return best;
+    };
+    const qint64 writerNs = bestOf2([&]() {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        QImageWriter writer(&buffer, "jpg");
+        writer.setQuality(75);
+        writer.write(sample);
+    });
+    const qint64 stripsNs = bestOf2([&]() { encode(sample, 75); });
+    const double speedup = double(writerNs) / qMax<qint64>(1, stripsNs);
+    qDebug().noquote() << QString("Info: JPEG strip encoder calibration: QImageWriter %1 ms, strips x%2 %3 ms, speedup %4 → %5")
+                          .arg(writerNs / 1e6, 0, 'f', 1).arg(QThread::idealThreadCount()).arg(stripsNs / 1e6, 0, 'f', 1)
+                          .arg(speedup, 0, 'f', 2).arg(speedup >= MIN_SPEEDUP ? "enabled" : "disabled");
+    return speedup;
+}
+
+QByteArray JpegStripEncoder::encode(const QImage& image, int quality, int threads)
+{
+    if (image.isNull() || image.width() > 65535 || image.height() > 65535) return QByteArray();
+    const QImage rgb = image.format() == QImage::Format_RGB888 ? image : image.convertToFormat(QImage::Format_RGB888);
+    if (threads <= 0) threads = QThread::idealThreadCount();
+
+    const Tables tables(quality);
+    const int mcuCols = (rgb.width() + 15) / 16;
+    const int mcuRows = (rgb.height() + 15) / 16;
+    // 横条数取线程数的4倍，内容不均匀（如半屏空白）时也能均衡负载；DRI 是 u16，限制每条的 MCU 数
+    const int maxRowsPerStrip = qMax(1, 65535 / mcuCols);
+    const int rowsPerStrip = qBound(1, (mcuRows + threads * 4 - 1) / (threads * 4), maxRowsPerStrip);
+    const int stripCount = (mcuRows + rowsPerStrip - 1) / rowsPerStrip;
+
+    QVector<QByteArray> strips(stripCount);
+    QAtomicInt next = 0;
+    auto work = [&]() {
+        for (int i = next.fetchAndAddRelaxed(1); i < stripCount; i = next.fetchAndAddRelaxed(1))
+            encodeStrip(rgb, tables, i * rowsPerStrip, qMin(mcuRows, (i + 1) * rowsPerStrip), &strips[i]);
+    };
+
+    const int helpers = qMin(threads, stripCount) - 1;
+    QThreadPool* pool = encoderPool();
+    if (pool->maxThreadCount() < helpers) pool->setMaxThreadCount(helpers);
+    QSemaphore done;
+    for (int i = 0; i < helpers; i++)
+        pool->start([&]() { work(); done.release(); });
+    work(); // 调用线程也干活
+    done.acquire(helpers);
+
+    QByteArray out;
+    int total = 1024;
+    for (const QByteArray& strip : strips) total += strip.size() + 2;
+    out.reserve(total);
+    appendHeaders(&out, tables, rgb.width(), rgb.height(), stripCount > 1 ? mcuCols * rowsPerStrip : 0);
+    for (int i = 0; i < stripCount; i++) {
+        out.append(strips[i]);
+        if (i + 1 < stripCount) appendMarker(&out, uchar(0xD0 + i % 8)); // RSTn
+    }
+    appendMarker(&out, 0xD9); // EOI
+    return out;
+}
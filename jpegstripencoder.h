@@ -0,0 +1,30 @@
+#ifndef JPEGSTRIPENCODER_H
+#define JPEGSTRIPENCODER_H
+
+#include <QImage>
+#include <QByteArray>
+
+// 并行 JPEG 编码：QImageWriter（libjpeg）只能单核编码，8K多屏截图要接近1秒
+// 按 MCU 行把图像切成横条，各线程独立编码，再用重启标记（RST0~RST7）拼接成一个标准的 JPEG 流：
+// - 每个横条恰好是一个重启区间（DRI = 每条的 MCU 数），区间开始时 DC 预测清零，横条之间没有依赖
+// - 基线 JPEG，YCbCr 4:2:0，标准 Huffman 表；量化表按 libjpeg 的 quality 缩放，大小与 QImageWriter 的输出相当
+// 小图并行收益不抵线程开销，应走 QImageWriter（见 ImageCodec::encodeAs）
+// 标量浮点 DCT 单核明显慢于 libjpeg-turbo（对比 SIMD 版约4倍），核心数本身说明不了是否划算：
+// 首次遇到大图时用它的一部分实测一次两者的耗时，加速比达到 MIN_SPEEDUP 才启用
+class JpegStripEncoder {
+private:
+    JpegStripEncoder() = delete;
+
+public:
+    // threads <= 0 时使用 QThread::idealThreadCount()；调用线程也参与编码
+    static QByteArray encode(const QImage& image, int quality, int threads = 0);
+    static bool worthIt(const QImage& image); // 足够大，且本机实测比 QImageWriter 快
+
+    static constexpr qint64 MIN_PIXELS = 3840LL * 1080; // 约半块4K屏，以下单核已足够快
+    static constexpr double MIN_SPEEDUP = 1.3; // 差不多持平时不值得占满所有核心；各线程数的加速比见 tools/codecbench --scaling
+
+private:
+    static double calibrate(const QImage& image); // 在 image 的一部分上实测 QImageWriter 耗时 / 并行编码耗时
+};
+
+#endif // JPEGSTRIPENCODER_H
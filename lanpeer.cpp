@@ -0,0 +1,349 @@
+#include "lanpeer.h"
+#include "util.h"
+#include "payloadcipher.h"
+#include <QUdpSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QNetworkDatagram>
+#include <QTimer>
+#include <QCryptographicHash>
+#include <QMessageAuthenticationCode>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QDebug>
+#include <memory>
+
+static const char RECORD_MAGIC[4] = {'D', 'P', 'L', 'N'};
+static const QByteArray ACK("DPOK");
+static constexpr int RECORD_HEADER_SIZE = 16; // magic + timestamp + frameLen
+static constexpr int MAC_SIZE = 32;
+static constexpr int ACK_SIZE = 4 + MAC_SIZE;
+
+LanPeer::LanPeer(QObject* parent)
+    : QObject(parent)
+{
+    announceTimer = new QTimer(this);
+    announceTimer->callOnTimeout(this, [=]() {
+        announce(QHostAddress::Broadcast);
+        announce(QHostAddress::LocalHost);
+    });
+}
+
+LanPeer::~LanPeer()
+{
+    stop(); // 通知对端下线
+}
+
+QByteArray LanPeer::deriveSecret(const QString& uuid, const QString& userId)
+{
+    // 与 hashId 同源，但经过 HMAC 单向派生（与端到端加密的密钥互不相同）
+    return QMessageAuthenticationCode::hash("dogpaw-lan-v1", (uuid + userId).toUtf8(), QCryptographicHash::Sha256);
+}
+
+void LanPeer::start(const QString& channel, const QByteArray& secret, const QString& deviceId, quint16 discoveryPort)
+{
+    stop();
+    this->channel = channel;
+    this->deviceId = deviceId;
+    this->discoveryPort = discoveryPort;
+    // 广播是明文，tag、HMAC 密钥、加密密钥分别由 secret 单向派生
+    this->key = QMessageAuthenticationCode::hash("mac", secret, QCryptographicHash::Sha256);
+    this->tag = QMessageAuthenticationCode::hash("tag", secret, QCryptographicHash::Sha256).toHex().left(16);
+    QSharedPointer<PayloadCipher> lanCipher(new PayloadCipher(QMessageAuthenticationCode::hash("enc", secret, QCryptographicHash::Sha256)));
+    if (!lanCipher->isValid()) {
+        qWarning() << "WARN: LAN direct transfer unavailable: AES-GCM unavailable.";
+        return;
+    }
+    this->cipher = lanCipher;
+
+    server = new QTcpServer(this);
+    if (!server->listen(QHostAddress::AnyIPv4)) {
+        qWarning() << "WARN: LAN direct transfer unavailable:" << server->errorString();
+        delete server;
+        server = nullptr;
+        return;
+    }
+    connect(server, &QTcpServer::newConnection, this, &LanPeer::acceptConnections);
+
+    udp = new QUdpSocket(this);
+    // 允许同一台机器上的多个实例共用发现端口
+    if (!udp->bind(QHostAddress::AnyIPv4, discoveryPort, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint))
+        qWarning() << "WARN: LAN discovery unavailable:" << udp->errorString();
+    connect(udp, &QUdpSocket::readyRead, this, &LanPeer::readDatagrams);
+
+    qDebug() << "+LAN peer listening on port" << server->serverPort();
+    announceTimer->start(ANNOUNCE_MS);
+    announce(QHostAddress::Broadcast);
+    announce(QHostAddress::LocalHost);
+}
+
+void LanPeer::stop()
+{
+    announceTimer->stop();
+    if (udp) {
+        announce(QHostAddress::Broadcast, true);
+        announce(QHostAddress::LocalHost, true);
+        delete udp;
+        udp = nullptr;
+    }
+    if (server) {
+        delete server; // 进行中的接收连接是其子对象，一并关闭
+        server = nullptr;
+    }
+    peers.clear();
+}
+
+bool LanPeer::hasPeers() const
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (const Peer& peer : peers)
+        if (now - peer.lastSeen <= PEER_TTL_MS) return true;
+    return false;
+}
+
+void LanPeer::send(const ClipPayload& payload, Callback cb)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QHash<QString, Peer> live;
+    for (auto it = peers.constBegin(); it != peers.constEnd(); ++it)
+        if (now - it->lastSeen <= PEER_TTL_MS) live.insert(it.key(), it.value());
+    if (live.isEmpty() || !server) {
+        cb({});
+        return;
+    }
+
+    const QByteArray frame = WireFormat::encodeBinary(payload, false, cipher.data()); // 局域网带宽充足，不压缩；始终加密
+    if (frame.size() > MAX_FRAME) { // 对端会拒收，直接走云端
+        cb({});
+        return;
+    }
+    const QByteArray record = seal(frame);
+    auto delivered = std::make_shared<QStringList>();
+    auto remaining = std::make_shared<int>(live.size());
+    QElapsedTimer timer;
+    timer.start();
+    for (auto it = live.constBegin(); it != live.constEnd(); ++it) {
+        const QString device = it.key();
+        sendTo(device, it.value(), record, [=](bool ok) { // ok：对端给出了正确的回执
+            if (ok) *delivered << device;
+            if (--*remaining > 0) return;
+            qDebug() << "↑Sent over LAN to" << delivered->size() << "/" << live.size() << "peer(s);"
+                     << Util::printDataSize(record.size()) << timer.elapsed() << "ms";
+            cb(*delivered);
+        });
+    }
+}
+
+void LanPeer::sendTo(const QString& device, const Peer& peer, const QByteArray& record, std::function<void(bool ok)> done)
+{
+    auto socket = new QTcpSocket(this);
+    auto finished = std::make_shared<bool>(false);
+    auto finish = [=](bool ok) {
+        if (*finished) return;
+        *finished = true;
+        if (!ok) {
+            qWarning() << "WARN: LAN transfer to" << device << "failed:" << socket->errorString();
+            peers.remove(device); // 等下次广播再加回，期间走云端
+        }
+        socket->abort();
+        socket->deleteLater();
+        done(ok);
+    };
+
+    auto timer = new QTimer(socket);
+    timer->setSingleShot(true);
+    timer->callOnTimeout(this, [=]() { finish(false); });
+    timer->start(TRANSFER_TIMEOUT_MS);
+
+    connect(socket, &QTcpSocket::connected, this, [=]() { socket->write(record); });
+    connect(socket, &QTcpSocket::readyRead, this, [=]() {
+        if (socket->bytesAvailable() < ACK_SIZE) return;
+        const QByteArray ack = socket->read(ACK_SIZE);
+        // 回执须由持有密钥的 device 针对本条记录计算，冒充者无法伪造，也不能重放别的回执
+        const bool ok = ack.startsWith(ACK) && equals(ack.mid(ACK.size()), ackMac(record.mid(RECORD_HEADER_SIZE, MAC_SIZE), device));
+        if (!ok) socket->setErrorString("Bad acknowledgement, not a device of this channel.");
+        finish(ok);
+    });
+    connect(socket, &QTcpSocket::errorOccurred, this, [=]() { finish(false); });
+    socket->connectToHost(peer.address, peer.port);
+}
+
+void LanPeer::announce(const QHostAddress& to, bool bye)
+{
+    if (!udp || !server) return;
+    const qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+    QJsonObject msg {
+        {"app", "dogpaw"},
+        {"device", deviceId},
+        {"tag", tag},
+        {"port", server->serverPort()},
+        {"ts", QString::number(timestamp)}, // JSON 数字是 double，毫秒时间戳用字符串保证精确
+        {"mac", QString(announceMac(deviceId, server->serverPort(), bye, timestamp).toHex())},
+    };
+    if (bye) msg.insert("bye", true);
+    udp->writeDatagram(QJsonDocument(msg).toJson(QJsonDocument::Compact), to, discoveryPort);
+}
+
+void LanPeer::readDatagrams()
+{
+    while (udp->hasPendingDatagrams()) {
+        const QNetworkDatagram datagram = udp->receiveDatagram(1024);
+        const QJsonObject msg = QJsonDocument::fromJson(datagram.data()).object();
+        const QString device = msg.value("device").toString();
+        if (msg.value("app").toString() != "dogpaw" || msg.value("tag").toString() != tag || device.isEmpty() || device == deviceId)
+            continue; // 其他应用、其他频道、自己的广播
+
+        // 只有同频道的设备能给出正确的 HMAC；时间戳限制重放窗口，窗口内的原样重放靠记录去重
+        const bool bye = msg.value("bye").toBool();
+        const int port = msg.value("port").toInt();
+        const qint64 timestamp = msg.value("ts").toString().toLongLong();
+        const QByteArray received = QByteArray::fromHex(msg.value("mac").toString().toLatin1());
+        if (qAbs(QDateTime::currentMSecsSinceEpoch() - timestamp) > MAX_CLOCK_SKEW_MS
+            || !equals(received, announceMac(device, port, bye, timestamp))) {
+            qWarning() << "WARN: Rejected LAN announcement from" << datagram.senderAddress();
+            continue;
+        }
+        if (recentAnnounceMacs.contains(received)) continue; // 同一条广播经回环 & 广播各收到一次，或被原样重放
+        recentAnnounceMacs << received;
+        if (recentAnnounceMacs.size() > 64) recentAnnounceMacs.removeFirst();
+
+        if (bye) {
+            if (peers.remove(device)) qDebug() << "-LAN peer left:" << device;
+            continue;
+        }
+        const bool isNew = !peers.contains(device);
+        Peer& peer = peers[device];
+        peer.address = datagram.senderAddress();
+        peer.port = quint16(port);
+        peer.lastSeen = QDateTime::currentMSecsSinceEpoch();
+        if (isNew) {
+            qDebug() << "+LAN peer found:" << device << peer.address << peer.port;
+            announce(peer.address); // 单播回复，对端无需等待下一轮广播
+        }
+    }
+}
+
+void LanPeer::acceptConnections()
+{
+    while (QTcpSocket* socket = server->nextPendingConnection()) {
+        if (inbound >= MAX_INBOUND) { // 认证前要缓冲整条记录，限制同时进行的连接数
+            qWarning() << "WARN: Too many LAN connections, drop" << socket->peerAddress();
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+        inbound++;
+        connect(socket, &QObject::destroyed, this, [=]() { inbound--; });
+        auto buffer = std::make_shared<QByteArray>();
+        auto timer = new QTimer(socket);
+        timer->setSingleShot(true);
+        timer->callOnTimeout(socket, &QTcpSocket::abort);
+        timer->start(TRANSFER_TIMEOUT_MS);
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+
+        connect(socket, &QTcpSocket::readyRead, this, [=]() {
+            *buffer += socket->readAll();
+            if (buffer->size() < RECORD_HEADER_SIZE + MAC_SIZE) return;
+            const uchar* p = reinterpret_cast<const uchar*>(buffer->constData());
+            const qint64 frameLen = qFromBigEndian<quint32>(p + 12);
+            const qint64 timestamp = qFromBigEndian<qint64>(p + 4);
+            if (memcmp(p, RECORD_MAGIC, 4) != 0 || frameLen > MAX_FRAME
+                || qAbs(QDateTime::currentMSecsSinceEpoch() - timestamp) > MAX_CLOCK_SKEW_MS) { // 过期的记录不必收完
+                socket->abort();
+                return;
+            }
+            if (buffer->size() < RECORD_HEADER_SIZE + MAC_SIZE + frameLen) {
+                timer->start(); // 仍有数据到达，超时顺延
+                return;
+            }
+
+            QByteArray frame;
+            ClipPayload payload;
+            if (!open(*buffer, &frame) || !WireFormat::decode(frame, WireFormat::BINARY_MIME, &payload, cipher.data())) {
+                qWarning() << "WARN: Rejected LAN transfer from" << socket->peerAddress();
+                socket->abort();
+                return;
+            }
+            socket->write(ACK + ackMac(buffer->mid(RECORD_HEADER_SIZE, MAC_SIZE), deviceId));
+            socket->disconnectFromHost();
+            const int wireSize = buffer->size();
+            buffer->clear();
+            emit payloadReceived(payload, wireSize);
+        });
+    }
+}
+
+QByteArray LanPeer::seal(const QByteArray& frame) const
+{
+    uchar header[RECORD_HEADER_SIZE];
+    memcpy(header, RECORD_MAGIC, 4);
+    qToBigEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 4);
+    qToBigEndian<quint32>(quint32(frame.size()), header + 12);
+    const QByteArray headerBytes(reinterpret_cast<const char*>(header), RECORD_HEADER_SIZE);
+
+    QByteArray record;
+    record.reserve(RECORD_HEADER_SIZE + MAC_SIZE + frame.size());
+    record.append(headerBytes);
+    record.append(mac(headerBytes, frame));
+    record.append(frame);
+    return record;
+}
+
+bool LanPeer::open(const QByteArray& record, QByteArray* frame)
+{
+    const uchar* p = reinterpret_cast<const uchar*>(record.constData());
+    const qint64 timestamp = qFromBigEndian<qint64>(p + 4);
+    if (qAbs(QDateTime::currentMSecsSinceEpoch() - timestamp) > MAX_CLOCK_SKEW_MS) {
+        qWarning() << "WARN: LAN transfer timestamp out of range.";
+        return false;
+    }
+    const int frameLen = int(qFromBigEndian<quint32>(p + 12));
+    *frame = record.mid(RECORD_HEADER_SIZE + MAC_SIZE, frameLen);
+    const QByteArray received = record.mid(RECORD_HEADER_SIZE, MAC_SIZE);
+    const QByteArray expected = mac(record.left(RECORD_HEADER_SIZE), *frame);
+
+    if (!equals(received, expected)) return false;
+
+    if (recentMacs.contains(received)) { // 时间窗口内的重放
+        qWarning() << "WARN: Replayed LAN transfer.";
+        return false;
+    }
+    recentMacs << received;
+    if (recentMacs.size() > 64) recentMacs.removeFirst();
+    return true;
+}
+
+QByteArray LanPeer::mac(const QByteArray& header, const QByteArray& frame) const
+{
+    QMessageAuthenticationCode code(QCryptographicHash::Sha256, key);
+    code.addData(header);
+    code.addData(frame);
+    return code.result();
+}
+
+QByteArray LanPeer::announceMac(const QString& device, int port, bool bye, qint64 timestamp) const
+{
+    const QString signedFields = QString("announce|%1|%2|%3|%4|%5").arg(tag, device).arg(port).arg(bye ? 1 : 0).arg(timestamp);
+    return QMessageAuthenticationCode::hash(signedFields.toUtf8(), key, QCryptographicHash::Sha256);
+}
+
+QByteArray LanPeer::ackMac(const QByteArray& recordMac, const QString& device) const
+{
+    QMessageAuthenticationCode code(QCryptographicHash::Sha256, key);
+    code.addData("ack|");
+    code.addData(recordMac);
+    code.addData(device.toUtf8());
+    return code.result();
+}
+
+bool LanPeer::equals(const QByteArray& a, const QByteArray& b)
+{
+    if (a.size() != b.size()) return false;
+    uchar diff = 0; // 定长比较，不因提前返回泄露匹配长度
+    for (int i = 0; i < a.size(); i++)
+        diff |= uchar(a[i] ^ b[i]);
+    return diff == 0;
+}
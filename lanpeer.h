@@ -0,0 +1,96 @@
+#ifndef LANPEER_H
+#define LANPEER_H
+
+#include <QObject>
+#include <QHash>
+#include <QHostAddress>
+#include <QStringList>
+#include <QSharedPointer>
+#include <functional>
+#include "wireformat.h"
+
+class QUdpSocket;
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+class PayloadCipher;
+
+// 局域网直连：同一网络内的设备直接用 TCP 传输，不绕道云端（同一张桌子上的两台电脑没必要走公网往返）
+// 所有密钥都由 uuid & userId 单向派生（见 deriveSecret），服务端知道的 hashId 推不出来；局域网内的其他主机无法冒充或窃听
+// - 发现：UDP 广播 {"app", "device", "tag", "port", "ts", "mac"}，tag 由密钥派生，同 tag 即同一频道
+//   mac = HMAC(device|port|bye|ts)，拒绝伪造、超过1分钟的广播以及原样重放
+//   收到新设备的广播后单播回复一次，双方立即互相发现；同时发往 127.0.0.1，便于单机双开测试
+// - 传输：每条消息一个 TCP 连接
+//   | "DPLN" | timestamp:i64 (ms) | frameLen:u32 | HMAC-SHA256:32B | frame |
+//   frame 为 WireFormat 二进制帧，始终以派生的密钥加密（AES-GCM，与是否开启端到端加密无关）
+//   HMAC 拒绝非同频道设备 & 超过1分钟的重放
+// - 回执：| "DPOK" | HMAC("ack" + 记录的HMAC + 接收方deviceId) |，记录的 HMAC 即挑战
+//   只有持有密钥的设备才能给出，发送方据此才认定送达（并告知云端跳过该设备）
+// 云端仍是汇合点和兜底：直连失败或对端不在局域网（如iOS）时照常走云端
+class LanPeer : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Callback = std::function<void(const QStringList& delivered)>;
+
+    explicit LanPeer(QObject* parent = nullptr);
+    ~LanPeer();
+
+    // secret 见 deriveSecret()，同一频道的设备相同
+    void start(const QString& channel, const QByteArray& secret, const QString& deviceId, quint16 discoveryPort = DISCOVERY_PORT);
+    void stop(void);
+    bool hasPeers(void) const;
+    // 发送给所有在线对端，全部结束（成功或失败）后回调成功送达的设备ID
+    void send(const ClipPayload& payload, Callback cb);
+
+    static QByteArray deriveSecret(const QString& uuid, const QString& userId);
+
+    static constexpr quint16 DISCOVERY_PORT = 45454;
+
+signals:
+    void payloadReceived(const ClipPayload& payload, int wireSize);
+
+private:
+    struct Peer {
+        QHostAddress address;
+        quint16 port = 0;
+        qint64 lastSeen = 0;
+    };
+
+    void announce(const QHostAddress& to, bool bye = false);
+    void readDatagrams(void);
+    void acceptConnections(void);
+    void sendTo(const QString& device, const Peer& peer, const QByteArray& record, std::function<void(bool ok)> done);
+    QByteArray seal(const QByteArray& frame) const;
+    bool open(const QByteArray& record, QByteArray* frame);
+    QByteArray mac(const QByteArray& header, const QByteArray& frame) const;
+    QByteArray announceMac(const QString& device, int port, bool bye, qint64 timestamp) const;
+    QByteArray ackMac(const QByteArray& recordMac, const QString& device) const;
+    static bool equals(const QByteArray& a, const QByteArray& b); // 定长比较
+
+private:
+    QUdpSocket* udp = nullptr;
+    QTcpServer* server = nullptr;
+    QTimer* announceTimer = nullptr;
+    QHash<QString, Peer> peers; // deviceId -> Peer
+    QString channel;
+    QString deviceId;
+    QString tag;
+    QByteArray key; // HMAC 密钥
+    QSharedPointer<const PayloadCipher> cipher; // 直连帧始终加密
+    QList<QByteArray> recentMacs; // 最近收到的记录，拒绝时间窗口内的重放
+    QList<QByteArray> recentAnnounceMacs; // 最近收到的广播，拒绝原样重放
+    int inbound = 0; // 进行中的接收连接
+    quint16 discoveryPort = DISCOVERY_PORT;
+
+    static constexpr int ANNOUNCE_MS = 10 * 1000;
+    static constexpr int PEER_TTL_MS = 3 * ANNOUNCE_MS + 5000; // 连续丢失3次广播才下线
+    static constexpr int TRANSFER_TIMEOUT_MS = 5000;
+    static constexpr qint64 MAX_CLOCK_SKEW_MS = 60 * 1000;
+    // 与云端的请求体上限一致（另留加密、元数据开销）：认证前整条缓冲在内存中，不能比接收内存上限（recv/memoryCapMB）宽松太多
+    static constexpr qint64 MAX_FRAME = WireFormat::MAX_BODY + 64 * 1024;
+    static constexpr int MAX_INBOUND = 4; // 未认证的连接最多同时缓冲这么多个
+};
+
+#endif // LANPEER_H
@@ -0,0 +1,210 @@
+#include "outboxjournal.h"
+#include "util.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QPointer>
+#include <QtEndian>
+#include <QDateTime>
+#include <QDebug>
+
+static const char RECORD_MAGIC[4] = {'D', 'P', 'J', '2'};
+static constexpr int RECORD_HEADER_SIZE = 10;
+
+OutboxJournal::OutboxJournal(const QString& filePath, QObject* parent)
+    : QObject(parent)
+    , filePath(filePath)
+{
+    ioPool = new QThreadPool(this);
+    ioPool->setMaxThreadCount(1); // 串行执行，保证记录顺序
+}
+
+OutboxJournal::~OutboxJournal()
+{
+    ioPool->waitForDone(); // 退出前写完，避免丢数据
+}
+
+void OutboxJournal::append(const QString& channel, const ClipPayload& payload)
+{
+    ioPool->start([=]() { // 析构时等待任务完成，this 在任务中始终有效
+        uchar savedAt[8];
+        qToBigEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), savedAt);
+        const QByteArray sealed = Util::protectData(QByteArray(reinterpret_cast<const char*>(savedAt), 8) + WireFormat::encodeBinary(payload));
+        if (sealed.isEmpty()) return; // 加密失败不落盘，宁可不重发也不留明文
+        if (sealed.size() > MAX_BYTES) {
+            qWarning() << "WARN: Payload too large for outbox, drop.";
+            return;
+        }
+        load();
+        if (writeRecord(channel, sealed))
+            qDebug() << "Outbox: saved" << Util::printDataSize(sealed.size()) << "for retry.";
+        compactIfNeeded();
+    });
+}
+
+void OutboxJournal::discard(const QString& channel)
+{
+    ioPool->start([=]() {
+        load();
+        if (!live.contains(channel)) return; // 没有待重发的数据，不必写墓碑
+        writeRecord(channel, QByteArray());
+        compactIfNeeded();
+    });
+}
+
+void OutboxJournal::takeLatest(const QString& channel, Callback cb)
+{
+    QPointer<OutboxJournal> self(this);
+    ioPool->start([=]() {
+        load();
+        if (!live.contains(channel)) return;
+        const Slot slot = live.value(channel);
+        const QByteArray plain = Util::unprotectData(readSealed(slot));
+        ClipPayload payload;
+        if (plain.size() <= 8 || !WireFormat::decode(plain.mid(8), WireFormat::BINARY_MIME, &payload)) {
+            qWarning() << "WARN: Outbox record unreadable, drop.";
+            removeIfLatest(channel, slot.seq);
+            return;
+        }
+        const qint64 ageMs = QDateTime::currentMSecsSinceEpoch() - qFromBigEndian<qint64>(reinterpret_cast<const uchar*>(plain.constData()));
+        if (ageMs > MAX_AGE_MS) {
+            qDebug() << "Outbox: drop stale record," << ageMs / 60000 << "min old.";
+            removeIfLatest(channel, slot.seq);
+            return;
+        }
+        QMetaObject::invokeMethod(self, [=]() { // 回到GUI线程
+            if (!self || !cb(payload)) return; // 未接手（如已有更新的数据在上传）则保留
+            OutboxJournal* journal = self; // 已进入上传队列才删除，重发失败会重新写入
+            journal->ioPool->start([=]() { journal->removeIfLatest(channel, slot.seq); });
+        }, Qt::QueuedConnection);
+    });
+}
+
+QByteArray OutboxJournal::makeRecord(const QString& channel, const QByteArray& frame)
+{
+    const QByteArray channelBytes = channel.toUtf8();
+    uchar header[RECORD_HEADER_SIZE];
+    memcpy(header, RECORD_MAGIC, 4);
+    qToBigEndian<quint16>(quint16(channelBytes.size()), header + 4);
+    qToBigEndian<quint32>(quint32(frame.size()), header + 6);
+
+    QByteArray record;
+    record.reserve(RECORD_HEADER_SIZE + channelBytes.size() + frame.size());
+    record.append(reinterpret_cast<const char*>(header), RECORD_HEADER_SIZE);
+    record.append(channelBytes);
+    record.append(frame);
+    return record;
+}
+
+void OutboxJournal::load()
+{
+    if (loaded) return;
+    loaded = true;
+    QFile file(filePath);
+    if (!file.exists() || !file.open(QIODevice::ReadWrite)) return;
+    qint64 offset = 0;
+    while (true) { // 只读记录头，跳过内容
+        const QByteArray header = file.read(RECORD_HEADER_SIZE);
+        if (header.size() < RECORD_HEADER_SIZE || memcmp(header.constData(), RECORD_MAGIC, 4) != 0)
+            break; // 结尾或损坏
+        const uchar* p = reinterpret_cast<const uchar*>(header.constData());
+        const int channelLen = qFromBigEndian<quint16>(p + 4);
+        const qint64 frameLen = qFromBigEndian<quint32>(p + 6);
+        if (frameLen > MAX_BYTES) break;
+        const QByteArray channel = file.read(channelLen);
+        const qint64 size = RECORD_HEADER_SIZE + channelLen + frameLen;
+        if (channel.size() < channelLen || offset + size > file.size())
+            break; // 不完整的尾部（写入时断电）
+        file.seek(offset + size);
+        const QString key = QString::fromUtf8(channel);
+        if (live.contains(key)) liveBytes -= live.value(key).size;
+        if (frameLen == 0) {
+            live.remove(key);
+        } else {
+            live.insert(key, Slot{nextSeq++, offset, size});
+            liveBytes += size;
+        }
+        recordCount++;
+        offset += size;
+    }
+    fileBytes = offset;
+    if (offset == 0 && file.size() > 0) { // 旧版本的明文日志（或整个损坏），不再保留
+        qWarning() << "WARN: Outbox journal unreadable or in the old plaintext format, removed.";
+        file.remove();
+    } else if (file.size() > offset) { // 截掉损坏的尾部，否则之后追加的记录读不到
+        qWarning() << "WARN: Outbox journal truncated at" << offset;
+        file.resize(offset);
+    }
+}
+
+bool OutboxJournal::writeRecord(const QString& channel, const QByteArray& frame)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::Append)) {
+        qWarning() << "WARN: Unable to open outbox journal:" << filePath;
+        return false;
+    }
+    // 单次 write，尽量减少断电时写出半条记录的可能；读取时会丢弃不完整的尾部
+    const QByteArray record = makeRecord(channel, frame);
+    if (file.write(record) != record.size() || !file.flush()) {
+        file.resize(fileBytes); // 不留半条记录
+        return false;
+    }
+    if (live.contains(channel)) liveBytes -= live.value(channel).size;
+    if (frame.isEmpty()) {
+        live.remove(channel);
+    } else {
+        live.insert(channel, Slot{nextSeq++, fileBytes, record.size()});
+        liveBytes += record.size();
+    }
+    recordCount++;
+    fileBytes += record.size();
+    return true;
+}
+
+QByteArray OutboxJournal::readSealed(const Slot& slot)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(slot.offset)) return QByteArray();
+    const QByteArray record = file.read(slot.size);
+    if (record.size() < slot.size) return QByteArray();
+    const int channelLen = qFromBigEndian<quint16>(reinterpret_cast<const uchar*>(record.constData()) + 4);
+    return record.mid(RECORD_HEADER_SIZE + channelLen);
+}
+
+void OutboxJournal::removeIfLatest(const QString& channel, quint64 seq)
+{
+    load();
+    if (!live.contains(channel) || live.value(channel).seq != seq) return; // 之后又写入了更新的数据，保留
+    writeRecord(channel, QByteArray());
+    compactIfNeeded();
+}
+
+void OutboxJournal::compactIfNeeded()
+{
+    if (live.isEmpty()) { // 全部作废，直接删除文件
+        if (fileBytes > 0) QFile::remove(filePath);
+        recordCount = 0;
+        fileBytes = liveBytes = 0;
+        return;
+    }
+    const qint64 deadBytes = fileBytes - liveBytes;
+    if (deadBytes == 0 || (recordCount <= MAX_RECORDS && fileBytes <= MAX_BYTES)) return;
+
+    QSaveFile file(filePath); // 原子替换，压缩过程中崩溃也不会丢失原日志
+    if (!file.open(QIODevice::WriteOnly)) return;
+    QHash<QString, Slot> moved;
+    qint64 offset = 0;
+    for (auto it = live.constBegin(); it != live.constEnd(); ++it) {
+        const QByteArray frame = readSealed(it.value());
+        if (frame.isEmpty()) continue;
+        const QByteArray record = makeRecord(it.key(), frame);
+        if (file.write(record) != record.size()) return; // 放弃，原日志不变
+        moved.insert(it.key(), Slot{it.value().seq, offset, record.size()}); // 序号不变
+        offset += record.size();
+    }
+    if (!file.commit()) return;
+    live = moved;
+    recordCount = live.size();
+    fileBytes = liveBytes = offset;
+    qDebug() << "Outbox: compacted to" << live.size() << "records, dropped" << Util::printDataSize(deadBytes);
+}
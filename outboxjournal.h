@@ -0,0 +1,69 @@
+#ifndef OUTBOXJOURNAL_H
+#define OUTBOXJOURNAL_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QHash>
+#include <functional>
+#include "wireformat.h"
+
+// 离线发件箱：上传失败的数据追加写入磁盘日志，恢复连接后自动重发
+// - 每个频道只保留最新一条（旧的重发已无意义，反而会覆盖新数据）
+// - 记录条数、文件大小都有上限，超出后压缩（只保留每个频道最新的一条）
+// - 所有文件 I/O 都在单线程的线程池中串行执行，不阻塞GUI线程
+// - 启动后只扫描一次日志，之后在内存中记录每个频道最新一条的位置与有效 / 作废字节数，追加、删除时不再重读文件
+// - 剪贴板内容可能是密码、令牌，记录用 DPAPI 加密后落盘（见 Util::protectData），只有当前 Windows 用户能解密
+// - 超过 MAX_AGE_MS 的记录不再重发，免得几天后重连时旧数据覆盖服务端更新的内容
+//
+// 记录格式（追加写入，大端序）：
+// | "DPJ2" | channelLen:u16 | sealedLen:u32 | channel | sealed |
+// sealed = DPAPI(savedAt:i64 毫秒时间戳 | WireFormat 二进制帧)；sealedLen == 0 表示删除该频道（墓碑）
+// 旧版本的 "DPJ1" 日志是明文，启动时整个丢弃
+class OutboxJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Callback = std::function<bool(const ClipPayload& payload)>; // 返回 true 表示已接手（进入上传队列）
+
+    explicit OutboxJournal(const QString& filePath, QObject* parent = nullptr);
+    ~OutboxJournal();
+
+    void append(const QString& channel, const ClipPayload& payload);
+    void discard(const QString& channel); // 有更新的数据上传成功，旧数据作废
+    // 取出该频道待重发的数据，有数据时在GUI线程回调；回调返回 true 才从日志中删除，否则留到下次重连
+    void takeLatest(const QString& channel, Callback cb);
+
+private:
+    struct Slot { // 某频道最新一条记录
+        quint64 seq;   // 写入序号，压缩后不变；取出到删除之间有新记录写入时据此判断，不误删新数据
+        qint64 offset; // 在文件中的位置
+        qint64 size;   // 整条记录的字节数
+    };
+
+    // 以下函数只在 I/O 线程中调用
+    static QByteArray makeRecord(const QString& channel, const QByteArray& frame);
+    void load(void); // 首次访问时扫描日志，截掉不完整的尾部
+    bool writeRecord(const QString& channel, const QByteArray& frame);
+    QByteArray readSealed(const Slot& slot);
+    void removeIfLatest(const QString& channel, quint64 seq);
+    void compactIfNeeded(void);
+
+private:
+    QString filePath;
+    QThreadPool* ioPool = nullptr;
+
+    // I/O 线程的状态
+    bool loaded = false;
+    QHash<QString, Slot> live;
+    quint64 nextSeq = 1;
+    int recordCount = 0;
+    qint64 fileBytes = 0; // 文件总大小 = 有效字节（live 中各条之和）+ 作废字节
+    qint64 liveBytes = 0;
+
+    static constexpr int MAX_RECORDS = 16;
+    static constexpr qint64 MAX_BYTES = 8 * 1024 * 1024;
+    static constexpr qint64 MAX_AGE_MS = 6 * 3600 * 1000; // 断线半天以上，剪贴板早已不是那时的内容
+};
+
+#endif // OUTBOXJOURNAL_H
@@ -0,0 +1,142 @@
+#include "payloadcipher.h"
+#include <QMessageAuthenticationCode>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QDebug>
+#include <Windows.h>
+#include <bcrypt.h>
+
+PayloadCipher::PayloadCipher(const QByteArray& key)
+{
+    Q_ASSERT(key.size() == 32);
+    BCRYPT_ALG_HANDLE alg = nullptr;
+    BCRYPT_KEY_HANDLE handle = nullptr;
+    NTSTATUS status = BCryptOpenAlgorithmProvider(&alg, BCRYPT_AES_ALGORITHM, nullptr, 0);
+    if (BCRYPT_SUCCESS(status))
+        status = BCryptSetProperty(alg, BCRYPT_CHAINING_MODE, (PUCHAR)BCRYPT_CHAIN_MODE_GCM, sizeof(BCRYPT_CHAIN_MODE_GCM), 0);
+    if (BCRYPT_SUCCESS(status))
+        status = BCryptGenerateSymmetricKey(alg, &handle, nullptr, 0, (PUCHAR)key.constData(), ULONG(key.size()), 0);
+    if (!BCRYPT_SUCCESS(status)) {
+        qCritical() << "× AES-GCM unavailable, NTSTATUS:" << Qt::hex << quint32(status);
+        if (alg) BCryptCloseAlgorithmProvider(alg, 0);
+        return;
+    }
+    algHandle = alg;
+    keyHandle = handle;
+}
+
+PayloadCipher::~PayloadCipher()
+{
+    if (keyHandle) BCryptDestroyKey(keyHandle);
+    if (algHandle) BCryptCloseAlgorithmProvider(algHandle, 0);
+}
+
+QByteArray PayloadCipher::deriveKey(const QString& uuid, const QString& userId)
+{
+    // 与 genHashID 同源，但经过 HMAC 单向派生：拿到 hashId 推不出密钥
+    return QMessageAuthenticationCode::hash("dogpaw-e2e-v1", (uuid + userId).toUtf8(), QCryptographicHash::Sha256);
+}
+
+int PayloadCipher::sealedSize(int plainSize)
+{
+    const int chunks = qMax(1, (plainSize + CHUNK_SIZE - 1) / CHUNK_SIZE); // 空数据也有一个（最后）块
+    return NONCE_PREFIX_SIZE + plainSize + chunks * TAG_SIZE;
+}
+
+bool PayloadCipher::crypt(bool encrypt, quint32 index, bool last, const uchar* prefix, const char* in, int size, char* out, uchar* tag) const
+{
+    uchar nonce[12];
+    memcpy(nonce, prefix, NONCE_PREFIX_SIZE);
+    qToBigEndian<quint32>(index, nonce + NONCE_PREFIX_SIZE);
+    uchar aad = last ? 1 : 0;
+
+    BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO info;
+    BCRYPT_INIT_AUTH_MODE_INFO(info);
+    info.pbNonce = nonce;
+    info.cbNonce = sizeof(nonce);
+    info.pbAuthData = &aad;
+    info.cbAuthData = sizeof(aad);
+    info.pbTag = tag;
+    info.cbTag = TAG_SIZE;
+
+    ULONG written = 0;
+    // 每块独立（不使用 CHAIN_CALLS），key handle 无状态，可被多个线程共用
+    const NTSTATUS status = encrypt
+        ? BCryptEncrypt(keyHandle, (PUCHAR)in, ULONG(size), &info, nullptr, 0, (PUCHAR)out, ULONG(size), &written, 0)
+        : BCryptDecrypt(keyHandle, (PUCHAR)in, ULONG(size), &info, nullptr, 0, (PUCHAR)out, ULONG(size), &written, 0);
+    return BCRYPT_SUCCESS(status) && int(written) == size;
+}
+
+bool PayloadCipher::seal(const char* plain, int size, char* out) const
+{
+    if (!isValid()) return false;
+    uchar* prefix = reinterpret_cast<uchar*>(out);
+    QRandomGenerator::system()->generate(prefix, prefix + NONCE_PREFIX_SIZE); // 每条消息随机，避免同一密钥下 nonce 重复
+    char* dst = out + NONCE_PREFIX_SIZE;
+
+    quint32 index = 0;
+    int offset = 0;
+    do {
+        const int len = qMin(CHUNK_SIZE, size - offset);
+        const bool last = offset + len >= size;
+        if (!crypt(true, index, last, prefix, plain + offset, len, dst, reinterpret_cast<uchar*>(dst + len)))
+            return false;
+        dst += len + TAG_SIZE;
+        offset += len;
+        index++;
+    } while (offset < size);
+    return true;
+}
+
+bool PayloadCipher::open(const char* sealed, int size, QByteArray* plain) const
+{
+    const int plainSize = openedSize(size);
+    if (plainSize < 0) return false;
+    plain->resize(plainSize);
+    if (!open(sealed, size, plain->data())) {
+        plain->clear(); // 密钥不一致，或数据被篡改 / 截断
+        return false;
+    }
+    return true;
+}
+
+bool PayloadCipher::open(const char* sealed, int size, char* plain) const
+{
+    const int plainSize = openedSize(size);
+    if (!isValid() || plainSize < 0) return false;
+    const uchar* prefix = reinterpret_cast<const uchar*>(sealed);
+    const int chunks = (size - NONCE_PREFIX_SIZE + CHUNK_SIZE + TAG_SIZE - 1) / (CHUNK_SIZE + TAG_SIZE);
+
+    const char* src = sealed + NONCE_PREFIX_SIZE;
+    for (int i = 0; i < chunks; i++) {
+        const int len = qMin(CHUNK_SIZE, plainSize - i * CHUNK_SIZE);
+        uchar tag[TAG_SIZE];
+        memcpy(tag, src + len, TAG_SIZE); // BCryptDecrypt 的 pbTag 是非const参数
+        if (!crypt(false, quint32(i), i == chunks - 1, prefix, src, len, plain + i * CHUNK_SIZE, tag))
+            return false;
+        src += len + TAG_SIZE;
+    }
+    return true;
+}
+
+int PayloadCipher::openedSize(int sealedSize)
+{
+    if (sealedSize < NONCE_PREFIX_SIZE + TAG_SIZE) return -1;
+    const int body = sealedSize - NONCE_PREFIX_SIZE;
+    const int chunks = (body + CHUNK_SIZE + TAG_SIZE - 1) / (CHUNK_SIZE + TAG_SIZE);
+    return body - chunks * TAG_SIZE;
+}
+
+double PayloadCipher::benchmark(int sizeBytes) const
+{
+    QByteArray plain(sizeBytes, Qt::Uninitialized);
+    QRandomGenerator::global()->generate(reinterpret_cast<quint32*>(plain.data()),
+                                         reinterpret_cast<quint32*>(plain.data() + (sizeBytes & ~3)));
+    QByteArray sealed(sealedSize(sizeBytes), Qt::Uninitialized);
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = seal(plain.constData(), plain.size(), sealed.data());
+    const qint64 ns = qMax<qint64>(1, timer.nsecsElapsed());
+    return ok ? sizeBytes / 1048576.0 / (ns / 1e9) : 0;
+}
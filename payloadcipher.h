@@ -0,0 +1,48 @@
+#ifndef PAYLOADCIPHER_H
+#define PAYLOADCIPHER_H
+
+#include <QByteArray>
+#include <QString>
+
+// 端到端加密：服务端只能看到密文（base64 只是编码，挡不住服务端）
+// - AES-256-GCM，使用 Windows CNG (BCrypt)，自动走 AES-NI / PCLMULQDQ 硬件加速
+// - 密钥 = HMAC-SHA256(uuid + userId, "dogpaw-e2e-v1")；服务端只知道 hashId = SHA256(uuid + userId)，无法反推
+// - 分块加密（64KB），直接从明文写入帧缓冲区，不产生额外的整份拷贝
+//
+// 密文格式：| noncePrefix:8B | chunk0 密文 + tag:16B | chunk1 ... | 最后一块 |
+// 每块 nonce = noncePrefix + 块序号(u32 大端)，AAD = 是否最后一块(u8)，防止块被重排、截断
+// iOS 快捷指令无法解密：只应在频道内都是 Dog-Paw 客户端时开启
+class PayloadCipher {
+public:
+    explicit PayloadCipher(const QByteArray& key);
+    ~PayloadCipher();
+    PayloadCipher(const PayloadCipher&) = delete;
+    PayloadCipher& operator=(const PayloadCipher&) = delete;
+
+    bool isValid(void) const { return keyHandle != nullptr; }
+    static QByteArray deriveKey(const QString& uuid, const QString& userId);
+
+    static int sealedSize(int plainSize);
+    // out 需预留 sealedSize(size) 字节
+    bool seal(const char* plain, int size, char* out) const;
+    bool open(const char* sealed, int size, QByteArray* plain) const;
+    // plain 需预留 openedSize(size) 字节（如映射的文件，超大消息不必放进内存）
+    bool open(const char* sealed, int size, char* plain) const;
+    static int openedSize(int sealedSize); // 密文格式不对时返回 -1
+
+    // 加密 sizeBytes 随机数据，返回吞吐量 MB/s（启动时打印一次，用于对比网络耗时）
+    double benchmark(int sizeBytes = 2 * 1024 * 1024) const;
+
+    static constexpr int CHUNK_SIZE = 64 * 1024;
+    static constexpr int TAG_SIZE = 16;
+    static constexpr int NONCE_PREFIX_SIZE = 8;
+
+private:
+    bool crypt(bool encrypt, quint32 index, bool last, const uchar* prefix, const char* in, int size, char* out, uchar* tag) const;
+
+private:
+    void* algHandle = nullptr; // BCRYPT_ALG_HANDLE，避免在头文件中引入 Windows.h
+    void* keyHandle = nullptr; // BCRYPT_KEY_HANDLE
+};
+
+#endif // PAYLOADCIPHER_H
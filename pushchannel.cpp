@@ -0,0 +1,384 @@
+#include "pushchannel.h"
+#include "wirestreamdecoder.h"
+#include "util.h"
+#include <QNetworkRequest>
+#include <QTimer>
+#include <QUrlQuery>
+#include <QFileInfo>
+#include <QDebug>
+
+PushChannel::PushChannel(QNetworkAccessManager* manager, QObject* parent)
+    : QObject(parent)
+    , manager(manager)
+{
+}
+
+PushChannel::~PushChannel() = default; // WireStreamDecoder 在此处才是完整类型
+
+void PushChannel::setHeartbeat(int intervalMs, int livenessMs)
+{
+    this->heartbeatMs = intervalMs;
+    this->livenessMs = livenessMs;
+}
+
+void PushChannel::start(const QString& baseUrl, const QStringList& channels, const QString& deviceId)
+{
+    Q_ASSERT(!channels.isEmpty());
+    stop();
+    this->baseUrl = baseUrl;
+    this->channels = channels;
+    this->deviceId = deviceId;
+    this->running = true;
+    this->multiplexed = true;
+    this->currentMode = sseEnabled ? SSE : LongPolling;
+    fallbackTimer.invalidate();
+    reconnectBackoff.reset();
+    setState(Connecting);
+
+    if (currentMode == SSE)
+        connectSse();
+    else
+        topUpPolls();
+}
+
+void PushChannel::stop()
+{
+    running = false;
+    generation++;
+    if (reply || !polls.isEmpty())
+        qDebug() << "Push channel stopped, abort old connection.";
+    // 先置空，abort()会同步触发finished
+    QList<QNetworkReply*> old = polls;
+    if (reply) old << reply;
+    reply = nullptr;
+    polls.clear();
+    for (QNetworkReply* r : old)
+        r->abort();
+    sseBuffer.clear();
+    resetSseEvent();
+}
+
+void PushChannel::connectSse()
+{
+    QNetworkRequest request(pushUrl("sse"));
+    request.setRawHeader("Accept", "text/event-stream");
+    request.setRawHeader("Cache-Control", "no-cache");
+    request.setRawHeader("X-Heartbeat-Interval", QByteArray::number(heartbeatMs / 1000));
+    // 传输超时是“无数据”超时，兜底不支持心跳的服务端
+    request.setTransferTimeout(90 * 1000);
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+
+    QNetworkReply* reply = manager->get(request);
+    reply->setProperty("probe", true); // 握手阶段的失败（如404）不代表断线，Widget据此忽略状态更新
+    this->reply = reply;
+    sseBuffer.clear();
+    resetSseEvent();
+    qDebug() << "+Connecting SSE push channel..." << (multiplexed ? "(multiplexed)" : "");
+
+    connect(reply, &QNetworkReply::metaDataChanged, this, [=]() {
+        if (reply != this->reply) return;
+        int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        const QString contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
+        if (statusCode == 200 && contentType.startsWith("text/event-stream")) {
+            reply->setProperty("probe", false);
+            sseOpenTimer.start();
+            qDebug() << "+SSE push channel opened."; // 响应头不算连接成功，收到事件或心跳才算（见 readyRead）
+        }
+    });
+
+    connect(reply, &QNetworkReply::readyRead, this, [=]() {
+        if (reply != this->reply) return;
+        if (reply->property("probe").toBool()) return; // 不是事件流，等待finished处理降级
+        sseBuffer += reply->readAll();
+        parseSseLines();
+        feedWatchdog(reply);
+        reply->setProperty("live", true);
+        onConnected(); // 收到事件或心跳，连接确实可用，才重置退避
+    });
+
+    connect(reply, &QNetworkReply::finished, this, [=]() {
+        reply->deleteLater();
+        if (reply != this->reply) return; // 已被stop()丢弃
+        this->reply = nullptr;
+
+        int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        bool wasOpened = !reply->property("probe").toBool();
+        qDebug() << "-SSE push channel closed." << statusCode << reply->errorString();
+
+        if (!wasOpened && statusCode != 0) { // 服务端有响应，但不是事件流：不支持SSE（多路复用的长轮询仍可能支持）
+            fallbackToLongPolling();
+            return;
+        }
+        // 收到过数据、且保持了一个存活检测周期以上的连接（含心跳超时的死连接），才立即重连
+        // 打开后很快断开（如代理返回事件流的响应头后立即断开）按失败退避，防止无延迟的重连循环
+        const bool stable = wasOpened && reply->property("live").toBool() && sseOpenTimer.elapsed() >= qMax(livenessMs, MIN_POLL_MS);
+        if (stable) {
+            setState(Connecting);
+            scheduleNext(0);
+        } else {
+            retryWithBackoff();
+        }
+    });
+}
+
+void PushChannel::topUpPolls()
+{
+    const int target = standbyPoll ? 2 : 1;
+    while (polls.size() < target)
+        startPoll();
+}
+
+void PushChannel::startPoll()
+{
+    QNetworkRequest request(pushUrl("long-polling"));
+    request.setRawHeader("Accept", WireFormat::ACCEPT); // 协商二进制格式，旧服务端会忽略并返回JSON
+    // 心跳：服务端先发响应头，再定期写入空白字符，超过 livenessMs 无数据就丢弃连接重连（Wi-Fi漫游后的半开连接）
+    request.setRawHeader("X-Heartbeat-Interval", QByteArray::number(heartbeatMs / 1000));
+    request.setTransferTimeout(90 * 1000); // 90s超时时间，兜底不支持心跳的服务端 & 网络异常造成的无响应永久等待
+    QNetworkReply* reply = manager->get(request);
+    reply->setProperty("mux", multiplexed);
+    reply->setProperty("probe", multiplexed); // 旧服务端对多路复用路由返回404，不代表断线
+    polls << reply;
+    QElapsedTimer pollTimer;
+    pollTimer.start();
+    qDebug() << "+Start long-polling..." << (polls.size() > 1 ? "(standby)" : "");
+    // 边收边解码：不再同时持有响应体、JSON 文档、base64 文本、解码结果（大图时约4份载荷）
+    auto decoder = QSharedPointer<WireStreamDecoder>::create(-1, memoryCap); // 超过内存上限的部分直接写盘
+
+    connect(reply, &QNetworkReply::metaDataChanged, this, [=]() {
+        const QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+        if (length.isValid() && decoder->isEmpty()) // 带心跳的响应没有 Content-Length，只能按需增长
+            decoder->setSizeHint(length.toLongLong());
+    });
+    connect(reply, &QNetworkReply::readyRead, this, [=]() {
+        if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200) return; // 错误页留给 finished 处理
+        decoder->feed(reply->readAll()); // 格式错误在 finished 时报告
+    });
+
+    connect(reply, &QNetworkReply::downloadProgress, this, [=](qint64 bytesReceived, qint64) {
+        if (!polls.contains(reply) || bytesReceived <= 0) return;
+        // 代理 / 重启中的后端返回的 502、503、404 错误页也有响应体，不能当作心跳，否则每次失败都重置退避并触发重发
+        if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200) return;
+        reply->setProperty("heartbeat", true); // 响应完成前就收到数据，说明服务端支持心跳
+        feedWatchdog(reply);
+        onConnected(); // 收到心跳即可确认连接正常，不必等到长轮询返回
+    });
+
+    connect(reply, &QNetworkReply::finished, this, [=]() {
+        reply->deleteLater();
+        if (!polls.removeOne(reply)) return; // 已被stop()丢弃
+
+        int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        qDebug() << "-Long polling done." << statusCode;
+        if (reply->property("mux").toBool() && statusCode == 404) {
+            if (multiplexed) fallbackToLegacy(); // 待命请求的404随之忽略
+            return;
+        }
+        if (reply->error() == QNetworkReply::NoError) {
+            if (statusCode == 200) decoder->feed(reply->readAll());
+            if (decoder->isEmpty() && pollTimer.elapsed() < MIN_POLL_MS) {
+                qWarning() << "WARN: Long polling returned too fast.";
+                retryWithBackoff();
+                return;
+            }
+            onConnected();
+            topUpPolls(); // 先发出下一次长轮询，再处理本次数据（解码图片等耗时操作），不留空窗
+            if (decoder->isEmpty()) return; // 长轮询超时的空响应 / 只有心跳
+            ClipPayload payload;
+            if (!decoder->finish(&payload, cipher.data())) {
+                qWarning() << "WARN: Unable to decode cloud message." << decoder->errorString() << decoder->wireSize();
+                return;
+            }
+            if (decoder->wireSize() > 64 * 1024) { // 大消息才值得关注内存峰值
+                const bool spilled = !payload.dataFile.isEmpty();
+                qDebug() << "Streamed decode:" << Util::printDataSize(decoder->wireSize()) << "->"
+                         << Util::printDataSize(spilled ? QFileInfo(payload.dataFile).size() : payload.data.size()) << (spilled ? "(on disk)" : "")
+                         << "; buffer high-water mark:" << Util::printDataSize(decoder->peakBytes());
+            }
+            emit payloadReceived(payload, int(decoder->wireSize()));
+        } else if (reply->property("dead").toBool()) { // 心跳超时的死连接，立即重连一次
+            setState(Connecting);
+            topUpPolls();
+        } else {
+            qCritical() << "× !!Get Error:" << reply->errorString();
+            retryWithBackoff();
+        }
+    });
+}
+
+void PushChannel::scheduleNext(int delayMs)
+{
+    const quint64 gen = generation;
+    QTimer::singleShot(delayMs, this, [=]() {
+        if (!running || gen != generation) return;
+        if (currentState == Backoff) setState(Connecting);
+
+        if (fallbackTimer.isValid() && fallbackTimer.elapsed() > UPGRADE_RETRY_MS) {
+            qDebug() << "Retry upgrading push channel.";
+            fallbackTimer.invalidate();
+            multiplexed = true;
+            if (sseEnabled) currentMode = SSE;
+        }
+
+        if (currentMode == SSE)
+            connectSse();
+        else
+            topUpPolls();
+    });
+}
+
+void PushChannel::setState(State state)
+{
+    if (state == currentState && state != Backoff) return; // Backoff 每次都通知，带上新的等待时间
+    currentState = state;
+    emit stateChanged(state, state == Backoff ? reconnectBackoff.delayMs() : 0);
+}
+
+void PushChannel::onConnected()
+{
+    reconnectBackoff.reset();
+    setState(Connected);
+}
+
+void PushChannel::retryWithBackoff()
+{
+    const int delayMs = reconnectBackoff.fail();
+    qDebug() << "Reconnect in" << delayMs << "ms, attempt" << reconnectBackoff.attemptCount();
+    setState(Backoff);
+    scheduleNext(delayMs);
+}
+
+void PushChannel::fallbackToLongPolling()
+{
+    qWarning() << "WARN: Server does not support SSE, fallback to long-polling.";
+    currentMode = LongPolling;
+    fallbackTimer.start();
+    topUpPolls(); // 立即发起，不留空窗
+}
+
+void PushChannel::fallbackToLegacy()
+{
+    qWarning() << "WARN: Server does not support multiplexed channels, subscribe" << channels.first() << "only.";
+    multiplexed = false;
+    fallbackTimer.start();
+    // 旧路由从 SSE 开始重新探测
+    if (sseEnabled) {
+        currentMode = SSE;
+        connectSse();
+    } else {
+        topUpPolls();
+    }
+}
+
+QUrl PushChannel::pushUrl(const QString& route) const
+{
+    if (!multiplexed)
+        return QUrl(QString("%1/clipboard/%2/%3/win").arg(baseUrl, route, channels.first()));
+
+    // 一个连接订阅所有频道
+    QUrl url(QString("%1/clipboard/mux/%2").arg(baseUrl, route));
+    QUrlQuery query;
+    query.addQueryItem("device", deviceId);
+    query.addQueryItem("channels", channels.join(','));
+    url.setQuery(query);
+    return url;
+}
+
+void PushChannel::parseSseLines()
+{
+    // https://html.spec.whatwg.org/multipage/server-sent-events.html#event-stream-interpretation
+    int lineStart = 0;
+    int newline;
+    while ((newline = sseBuffer.indexOf('\n', lineStart)) != -1) {
+        QByteArray line = sseBuffer.mid(lineStart, newline - lineStart);
+        lineStart = newline + 1;
+        if (line.endsWith('\r')) line.chop(1);
+
+        if (sseInData) { // data 行的剩余部分
+            sseInData = false;
+            feedSseData(line.constData(), line.size(), false);
+            continue;
+        }
+        if (line.isEmpty()) { // 空行：事件结束
+            dispatchSseEvent();
+            continue;
+        }
+        if (line.startsWith(':')) { // 注释行，服务端心跳
+            if (reply) reply->setProperty("heartbeat", true);
+            continue;
+        }
+
+        int colon = line.indexOf(':');
+        QByteArray field = colon == -1 ? line : line.left(colon);
+        QByteArray value = colon == -1 ? QByteArray() : line.mid(colon + 1);
+        if (value.startsWith(' ')) value.remove(0, 1);
+
+        if (field == "data")
+            feedSseData(value.constData(), value.size(), true);
+    }
+    sseBuffer.remove(0, lineStart);
+
+    // 大图的 data 行可达数MB，不等换行，已收到的部分先喂给解码器（保留末尾的 \r，可能是行尾）
+    const bool dataLine = sseInData || (sseBuffer.size() > 5 && sseBuffer.startsWith("data:"));
+    if (!dataLine) return;
+    int skip = 0;
+    if (!sseInData) {
+        skip = sseBuffer.at(5) == ' ' ? 6 : 5;
+        feedSseData(nullptr, 0, true);
+        sseInData = true;
+    }
+    const int n = sseBuffer.size() - (sseBuffer.endsWith('\r') ? 1 : 0);
+    feedSseData(sseBuffer.constData() + skip, n - skip, false);
+    sseBuffer.remove(0, n);
+}
+
+void PushChannel::feedSseData(const char* data, int size, bool lineStart)
+{
+    if (!sseDecoder) sseDecoder.reset(new WireStreamDecoder(-1, memoryCap)); // 事件流只能承载文本，固定为JSON
+    if (lineStart && sseDataLines++ > 0) sseDecoder->feed("\n", 1);
+    if (size > 0) sseDecoder->feed(data, size); // 格式错误在事件结束时报告
+}
+
+void PushChannel::dispatchSseEvent()
+{
+    if (!sseDecoder) return;
+    QScopedPointer<WireStreamDecoder> decoder(sseDecoder.take());
+    resetSseEvent();
+    ClipPayload payload;
+    if (!decoder->finish(&payload, cipher.data())) {
+        qWarning() << "WARN: Unable to decode cloud message." << decoder->errorString() << decoder->wireSize();
+        return;
+    }
+    if (!decoder->isEmpty())
+        emit payloadReceived(payload, int(decoder->wireSize()));
+}
+
+void PushChannel::resetSseEvent()
+{
+    sseDecoder.reset(); // 未完成的事件随之丢弃（含临时文件）
+    sseDataLines = 0;
+    sseInData = false;
+}
+
+void PushChannel::feedWatchdog(QNetworkReply* reply)
+{
+    // 服务端确实在发心跳（旧服务端不会），才启用存活检测
+    if (!reply->property("heartbeat").toBool() || livenessMs <= 0) return;
+
+    auto watchdog = reply->findChild<QTimer*>("watchdog", Qt::FindDirectChildrenOnly);
+    if (!watchdog) { // 随 reply 一起销毁
+        watchdog = new QTimer(reply);
+        watchdog->setObjectName("watchdog");
+        watchdog->setSingleShot(true);
+        watchdog->callOnTimeout(this, [=]() { onConnectionDead(reply); });
+    }
+    watchdog->start(livenessMs);
+}
+
+void PushChannel::onConnectionDead(QNetworkReply* reply)
+{
+    if (reply->isFinished()) return;
+    qWarning() << "WARN: No heartbeat for" << livenessMs << "ms, drop half-open connection & reconnect.";
+    reply->setProperty("dead", true);
+    reply->abort(); // 同步触发finished，立即重连
+}
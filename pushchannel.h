@@ -0,0 +1,113 @@
+#ifndef PUSHCHANNEL_H
+#define PUSHCHANNEL_H
+
+#include <QObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QSharedPointer>
+#include <QScopedPointer>
+#include "reconnectbackoff.h"
+#include "wireformat.h"
+
+class PayloadCipher;
+class WireStreamDecoder;
+
+// 云端推送通道：优先使用 SSE (Server-Sent Events) 长连接，一个连接承载多条消息
+// 服务端不支持时，自动降级为原有的长轮询（long-polling）
+// 多路复用：一个连接同时订阅多个频道（hashId），消息带有 channel & origin（发送设备ID），服务端向频道内其他设备扇出
+// 旧服务端没有 /clipboard/mux 路由（404）时，退回 /{hashId}/win 路由，只订阅第一个频道
+// 长轮询的响应随 readyRead 增量解码（见 WireStreamDecoder），不等响应结束再整体解析；SSE 的 data 行同样边收边解码
+class PushChannel : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Mode {
+        SSE,
+        LongPolling
+    };
+
+    // 重连状态机：Connecting -> Connected；失败 -> Backoff（指数退避 + 抖动）-> Connecting
+    enum State {
+        Connecting,
+        Connected,
+        Backoff
+    };
+
+    explicit PushChannel(QNetworkAccessManager* manager, QObject* parent = nullptr);
+    ~PushChannel();
+
+    // channels 第一个为主频道（旧服务端只能订阅它）；deviceId 用于服务端区分同一频道内的多台设备
+    void start(const QString& baseUrl, const QStringList& channels, const QString& deviceId);
+    void stop(void);
+    Mode mode(void) const { return currentMode; }
+    bool isMultiplexed(void) const { return multiplexed; }
+    State state(void) const { return currentState; }
+    const ReconnectBackoff& backoff(void) const { return reconnectBackoff; }
+    void setSseEnabled(bool enabled) { sseEnabled = enabled; }
+    // 心跳：请求服务端每 intervalMs 发送保活数据（SSE注释行 / 长轮询响应体前的空白）
+    // 收到过一次心跳后，超过 livenessMs 无任何数据即判定为半开连接，立即断开重连
+    void setHeartbeat(int intervalMs, int livenessMs);
+    // 长轮询时额外保持一个待命请求，前一个返回到下一个发出之间，服务端始终有监听者
+    void setStandbyPoll(bool enabled) { standbyPoll = enabled; }
+    void setCipher(QSharedPointer<const PayloadCipher> cipher) { this->cipher = cipher; } // 解密端到端加密的消息
+    // 消息解码后超过 bytes 即转存到临时文件（ClipPayload::dataFile），<= 0 表示不限制
+    void setMemoryCap(qint64 bytes) { memoryCap = bytes; }
+
+signals:
+    void payloadReceived(const ClipPayload& payload, int wireSize);
+    void stateChanged(PushChannel::State state, int retryDelayMs);
+
+private:
+    void connectSse(void);
+    void startPoll(void);
+    void topUpPolls(void);
+    void scheduleNext(int delayMs);
+    void setState(State state);
+    void onConnected(void);
+    void retryWithBackoff(void);
+    void fallbackToLongPolling(void);
+    void fallbackToLegacy(void);
+    QUrl pushUrl(const QString& route) const;
+    void parseSseLines(void);
+    void feedSseData(const char* data, int size, bool lineStart);
+    void dispatchSseEvent(void);
+    void resetSseEvent(void);
+    void feedWatchdog(QNetworkReply* reply);
+    void onConnectionDead(QNetworkReply* reply);
+
+private:
+    QNetworkAccessManager* manager = nullptr;
+    QNetworkReply* reply = nullptr;    // SSE 连接
+    QList<QNetworkReply*> polls;       // 进行中的长轮询（含待命请求）
+    bool standbyPoll = false;
+    QString baseUrl;
+    QStringList channels;
+    QString deviceId;
+    bool multiplexed = true; // 服务端支持 /clipboard/mux（404 时置为false）
+    Mode currentMode = SSE;
+    State currentState = Connecting;
+    ReconnectBackoff reconnectBackoff;
+    bool sseEnabled = true;
+    bool running = false;
+    QSharedPointer<const PayloadCipher> cipher;
+    qint64 memoryCap = 0;
+    quint64 generation = 0; // start()/stop() 时递增，丢弃过期的定时回调
+
+    QByteArray sseBuffer;   // 尚未组成完整行的数据
+    QScopedPointer<WireStreamDecoder> sseDecoder; // 当前事件的 data 字段，边收边解码
+    int sseDataLines = 0;   // 当前事件已有的 data 行数（多行之间以换行连接）
+    bool sseInData = false; // sseBuffer 中未完的 data 行，前半段已喂给解码器
+    QElapsedTimer fallbackTimer; // 降级后计时，定期重新尝试升级（SSE & 多路复用）
+    QElapsedTimer sseOpenTimer;  // 当前事件流打开的时长
+
+    int heartbeatMs = 5000;
+    int livenessMs = 12000;
+
+    static constexpr int MIN_POLL_MS = 1000; // 空响应快于此值视为异常（如代理直接返回），按失败退避，防止紧循环
+    static constexpr int UPGRADE_RETRY_MS = 10 * 60 * 1000; // 降级后每10分钟重新尝试一次升级
+};
+
+#endif // PUSHCHANNEL_H
@@ -0,0 +1,93 @@
+#include "receivepipeline.h"
+#include "util.h"
+#include <QBuffer>
+#include <QImageReader>
+#include <QFile>
+#include <QMimeDatabase>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QScopeGuard>
+#include <QDebug>
+
+ReceivePipeline::ReceivePipeline(QObject* parent)
+    : QObject(parent)
+{
+    pool = new QThreadPool(this);
+    pool->setMaxThreadCount(2); // 过时的任务还在解码时，新消息无需排队等待
+}
+
+ReceivePipeline::~ReceivePipeline()
+{
+    cancel(); // 作废所有任务
+    pool->clear(); // 未开始的任务不会执行，落盘的临时文件留给系统清理
+    pool->waitForDone();
+}
+
+void ReceivePipeline::submit(const ClipPayload& payload, Callback cb)
+{
+    const quint64 gen = generation.fetchAndAddOrdered(1) + 1;
+    QPointer<ReceivePipeline> self(this);
+    pool->start([=]() {
+        auto removeSpill = qScopeGuard([&]{ if (!payload.dataFile.isEmpty()) QFile::remove(payload.dataFile); });
+        if (isStale(gen)) return; // 排队期间已有更新的消息
+
+        QElapsedTimer timer;
+        timer.start();
+        ReceivedImage result;
+        const QImage thumbnail = read(payload, THUMB_SIZE);
+        const qint64 thumbMs = timer.restart();
+        if (!thumbnail.isNull())
+            result.thumbPath = Util::saveImageToTemp(thumbnail, "jpg");
+        const qint64 saveMs = timer.restart();
+        if (isStale(gen)) return;
+
+        result.image = read(payload, QSize());
+        result.decodeMs = timer.elapsed();
+        if (isStale(gen)) return;
+
+        // 按内容（而非扩展名）识别原始格式
+        QMimeDatabase db;
+        const QMimeType type = payload.dataFile.isEmpty() ? db.mimeTypeForData(payload.data)
+                                                          : db.mimeTypeForFile(payload.dataFile, QMimeDatabase::MatchContent);
+        if (type.name().startsWith("image/")) {
+            result.mimeType = type.name();
+            result.suffix = type.preferredSuffix();
+            result.encoded = payload.data;
+            result.encodedFile = payload.dataFile;
+        }
+
+        qDebug().noquote() << QString("Receive pipeline: thumbnail %1 ms | save %2 ms | decode %3 ms; %4 × %5 %6")
+                              .arg(thumbMs).arg(saveMs).arg(result.decodeMs)
+                              .arg(result.image.width()).arg(result.image.height()).arg(result.mimeType);
+
+        if (!result.encodedFile.isEmpty()) removeSpill.dismiss(); // 原图文件交给接收方
+        QMetaObject::invokeMethod(self, [=]() { // 回到GUI线程
+            if (!self || self->isStale(gen)) { // 解码期间已有更新的消息
+                if (!result.encodedFile.isEmpty()) QFile::remove(result.encodedFile);
+                return;
+            }
+            cb(result);
+        }, Qt::QueuedConnection);
+    });
+}
+
+QImage ReceivePipeline::read(const ClipPayload& payload, const QSize& box)
+{
+    QBuffer buffer; // 与 payload.data 隐式共享，不拷贝
+    buffer.setData(payload.data);
+    QImageReader reader;
+    if (payload.dataFile.isEmpty())
+        reader.setDevice(&buffer);
+    else
+        reader.setFileName(payload.dataFile);
+
+    const QSize size = reader.size(); // 只读文件头
+    if (box.isValid() && size.isValid()) {
+        const QSize scaled = size.scaled(box, Qt::KeepAspectRatioByExpanding);
+        if (scaled.width() < size.width()) reader.setScaledSize(scaled); // 小图不放大
+    }
+    const QImage image = reader.read();
+    if (image.isNull())
+        qWarning() << "WARN: Unable to decode received image:" << reader.errorString();
+    return image;
+}
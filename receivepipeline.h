@@ -0,0 +1,53 @@
+#ifndef RECEIVEPIPELINE_H
+#define RECEIVEPIPELINE_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QImage>
+#include <QAtomicInteger>
+#include <functional>
+#include "wireformat.h"
+
+// 收到的图像在工作线程中解码；原始编码字节一并保留，保存 / 粘贴原图时不必重新编码
+struct ReceivedImage {
+    QImage image;      // 放入剪贴板的位图，解码失败（如没有 HEIC 插件）时为空
+    QString thumbPath; // Toast 预览图（临时文件）
+    QString mimeType;  // 原始编码格式（如 image/jpeg），无法识别时为空
+    QString suffix;    // 对应的扩展名（如 jpg）
+    QByteArray encoded;  // 原始编码字节（与 ClipPayload::data 隐式共享）
+    QString encodedFile; // 落盘的大图：原始字节在该文件中（encoded 为空），由接收方负责删除（见 DeferredMimeData）
+    qint64 decodeMs = 0;
+
+    bool isEmpty(void) const { return image.isNull() && mimeType.isEmpty(); }
+};
+
+// 接收流水线：与 CapturePipeline 对称，图像解码、Toast 预览图的缩放与 jpg 编码、写入临时文件都在线程池中完成
+// 预览图用 QImageReader::setScaledSize 直接按目标尺寸解码（JPEG 在 IDCT 阶段即缩小），不再先解码原图再缩放
+// GUI线程只负责最后放入剪贴板（见 DeferredMimeData）与弹出 Toast，大图不再卡住托盘
+// latest-wins：新的消息到达（或调用 cancel()）后，尚未完成的旧任务不再回调
+class ReceivePipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Callback = std::function<void(const ReceivedImage& result)>;
+
+    explicit ReceivePipeline(QObject* parent = nullptr);
+    ~ReceivePipeline();
+
+    // 完成后在GUI线程回调；payload.dataFile（落盘的大图）作为 ReceivedImage::encodedFile 交给回调，任务作废时由流水线删除
+    void submit(const ClipPayload& payload, Callback cb);
+    void cancel(void) { generation.fetchAndAddOrdered(1); } // 之后到达的文本等覆盖了剪贴板，旧图像作废
+
+    static constexpr QSize THUMB_SIZE {364, 180}; // Toast hero image 的显示尺寸
+
+private:
+    bool isStale(quint64 gen) const { return gen != generation.loadAcquire(); }
+    static QImage read(const ClipPayload& payload, const QSize& box); // box 有效时按比例缩小解码，铺满 box
+
+private:
+    QThreadPool* pool = nullptr;
+    QAtomicInteger<quint64> generation = 0;
+};
+
+#endif // RECEIVEPIPELINE_H
@@ -0,0 +1,39 @@
+#ifndef RECONNECTBACKOFF_H
+#define RECONNECTBACKOFF_H
+
+#include <QRandomGenerator>
+#include <QtGlobal>
+
+// 重连退避：失败后等待 base * 2^n（不超过 cap），再加随机抖动
+// 抖动避免服务端重启后所有客户端同一时刻一起重连（惊群）
+// 成功后归零，下一次请求立即发出
+class ReconnectBackoff {
+public:
+    explicit ReconnectBackoff(int baseMs = 1000, int capMs = 60 * 1000) : baseMs(baseMs), capMs(capMs) {}
+
+    // 记录一次失败，返回本次应等待的时间
+    int fail() {
+        const int exp = qMin(attempts, 16); // 防止移位溢出
+        const int ceiling = int(qMin<qint64>(capMs, qint64(baseMs) << exp));
+        attempts++;
+        // equal jitter: [ceiling/2, ceiling]，既分散重连时刻，又不会退化成0延迟的紧循环
+        lastDelayMs = ceiling / 2 + int(QRandomGenerator::global()->bounded(ceiling / 2 + 1));
+        return lastDelayMs;
+    }
+
+    void reset() {
+        attempts = 0;
+        lastDelayMs = 0;
+    }
+
+    int attemptCount() const { return attempts; }
+    int delayMs() const { return lastDelayMs; }
+
+private:
+    int baseMs;
+    int capMs;
+    int attempts = 0;
+    int lastDelayMs = 0;
+};
+
+#endif // RECONNECTBACKOFF_H
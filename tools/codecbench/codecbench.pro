@@ -0,0 +1,21 @@
+QT += core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# 与客户端共用同一份选择逻辑
+INCLUDEPATH += ../..
+SOURCES += \
+    ../../imagecodec.cpp \
+    ../../jpegstripencoder.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../imagecodec.h \
+    ../../jpegstripencoder.h
+
+msvc {
+    QMAKE_CXXFLAGS += /utf-8
+}
+
+TARGET = codecbench
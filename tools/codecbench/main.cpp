@@ -0,0 +1,279 @@
+// 图像编码对比：每个样本用各编解码器编码，输出 大小 / 耗时 / PSNR，并标出 ImageCodec::encode 的选择（*）
+//
+//     codecbench [图片文件或目录 ...]
+//     codecbench --scaling [图片文件 ...]   并行 JPEG（JpegStripEncoder）随线程数的加速比，默认用合成的 4K / 8K 截图
+//
+// 不带参数时使用内置的合成样本（UI截图、图表、照片），真实结论请用自己的剪贴板截图跑一遍
+// 耗时取3次最好成绩；PSNR 以 RGB 计算，无损为 inf，> 40dB 肉眼基本不可分辨
+
+#include "imagecodec.h"
+#include "jpegstripencoder.h"
+#include <QImageWriter>
+#include <QBuffer>
+#include <QThread>
+#include <QGuiApplication>
+#include <QImageReader>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QPainter>
+#include <QLinearGradient>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <cmath>
+#include <functional>
+
+struct Codec {
+    QString name;
+    QByteArray format;
+    int quality;
+};
+
+static QList<Codec> codecs()
+{
+    QList<Codec> list {
+        {"png8", "png8", -1},
+        {"png", "png", -1},
+        {"jpg-85", "jpg", 85},
+        {"jpg-70", "jpg", 70},
+        {"jpg-50", "jpg", 50},
+    };
+    if (ImageCodec::hasWebP()) {
+        list << Codec{"webp-lossless", "webp", 100};
+        list << Codec{"webp-80", "webp", 80};
+    }
+    return list;
+}
+
+static QString choiceName(const ImageCodec::Result& result)
+{
+    if (result.format == "jpg") return QString("jpg-%1").arg(result.quality);
+    if (result.format == "webp") return "webp-lossless";
+    return result.indexed ? "png8" : "png";
+}
+
+static double psnr(const QImage& original, const QByteArray& encoded)
+{
+    const QImage a = original.convertToFormat(QImage::Format_RGB32);
+    const QImage b = QImage::fromData(encoded).convertToFormat(QImage::Format_RGB32);
+    if (a.size() != b.size()) return 0;
+    double sum = 0;
+    for (int y = 0; y < a.height(); y++) {
+        const QRgb* la = reinterpret_cast<const QRgb*>(a.constScanLine(y));
+        const QRgb* lb = reinterpret_cast<const QRgb*>(b.constScanLine(y));
+        for (int x = 0; x < a.width(); x++) {
+            const int dr = qRed(la[x]) - qRed(lb[x]), dg = qGreen(la[x]) - qGreen(lb[x]), db = qBlue(la[x]) - qBlue(lb[x]);
+            sum += dr * dr + dg * dg + db * db;
+        }
+    }
+    const double mse = sum / (3.0 * a.width() * a.height());
+    return mse == 0 ? INFINITY : 10 * std::log10(255.0 * 255.0 / mse);
+}
+
+// 合成样本：接近常见剪贴板内容，但只用于快速回归，不代替真实截图
+static QList<QPair<QString, QImage>> syntheticCorpus()
+{
+    QList<QPair<QString, QImage>> corpus;
+
+    QImage ui(1920, 1080, QImage::Format_RGB32); // IDE / 聊天窗口：大片纯色 + 抗锯齿文字
+    ui.fill(QColor(30, 30, 30));
+    {
+        QPainter p(&ui);
+        p.fillRect(0, 0, 260, 1080, QColor(37, 37, 38));
+        p.fillRect(0, 0, 1920, 32, QColor(51, 51, 51));
+        QFont font("Consolas", 11);
+        p.setFont(font);
+        const QColor colors[] = {QColor(86, 156, 214), QColor(206, 145, 120), QColor(220, 220, 170), QColor(212, 212, 212)};
+        for (int line = 0; line < 50; line++) {
+            p.setPen(colors[line % 4]);
+            p.drawText(280 + (line % 5) * 16, 60 + line * 20, QString("auto value_%1 = compute(%2, \"text\"); // comment").arg(line).arg(line * 7));
+        }
+    }
+    corpus << qMakePair(QString("synthetic-ui"), ui);
+
+    QImage chart(1200, 800, QImage::Format_RGB32); // 图表：少量纯色
+    chart.fill(Qt::white);
+    {
+        QPainter p(&chart);
+        const QColor bars[] = {QColor("#4e79a7"), QColor("#f28e2b"), QColor("#e15759"), QColor("#76b7b2")};
+        for (int i = 0; i < 12; i++)
+            p.fillRect(80 + i * 90, 700 - (i * 37 % 500) - 100, 60, (i * 37 % 500) + 100, bars[i % 4]);
+        p.setPen(Qt::black);
+        p.drawLine(60, 700, 1160, 700);
+        p.drawLine(60, 100, 60, 700);
+    }
+    corpus << qMakePair(QString("synthetic-chart"), chart);
+
+    QImage photo(1920, 1080, QImage::Format_RGB32); // 照片：渐变 + 传感器噪声
+    {
+        QPainter p(&photo);
+        QLinearGradient gradient(0, 0, 1920, 1080);
+        gradient.setColorAt(0, QColor(40, 90, 160));
+        gradient.setColorAt(0.6, QColor(230, 180, 120));
+        gradient.setColorAt(1, QColor(60, 110, 50));
+        p.fillRect(photo.rect(), gradient);
+    }
+    QRandomGenerator rng(42);
+    for (int y = 0; y < photo.height(); y++) {
+        QRgb* line = reinterpret_cast<QRgb*>(photo.scanLine(y));
+        for (int x = 0; x < photo.width(); x++) {
+            const int n = int(rng.bounded(13)) - 6;
+            line[x] = qRgb(qBound(0, qRed(line[x]) + n, 255), qBound(0, qGreen(line[x]) + n, 255), qBound(0, qBlue(line[x]) + n, 255));
+        }
+    }
+    corpus << qMakePair(QString("synthetic-photo"), photo);
+    return corpus;
+}
+
+// 多屏截图：把 UI 样本平铺到 4K / 8K
+static QImage tiledCapture(const QImage& tile, int width, int height)
+{
+    QImage capture(width, height, QImage::Format_RGB32);
+    QPainter p(&capture);
+    for (int y = 0; y < height; y += tile.height())
+        for (int x = 0; x < width; x += tile.width())
+            p.drawImage(x, y, tile);
+    return capture;
+}
+
+static double bestOf3(const std::function<QByteArray()>& encode, int* size)
+{
+    double best = INFINITY;
+    for (int round = 0; round < 3; round++) {
+        QElapsedTimer timer;
+        timer.start();
+        *size = encode().size();
+        best = qMin(best, timer.nsecsElapsed() / 1e6);
+    }
+    return best;
+}
+
+// QImageWriter（单核 libjpeg） vs JpegStripEncoder 1, 2, 4 ... idealThreadCount 个线程，质量均为 85
+static void scaling(QTextStream& out, const QList<QPair<QString, QImage>>& corpus)
+{
+    QList<int> threads;
+    for (int n = 1; n < QThread::idealThreadCount(); n *= 2) threads << n;
+    threads << QThread::idealThreadCount();
+
+    out << QString("%1 %2").arg("sample", -28).arg("QImageWriter", 20);
+    for (int n : threads) out << QString("%1").arg(QString("strips x%1").arg(n), 24);
+    out << "\n";
+    for (const auto& sample : corpus) {
+        const QImage rgb = sample.second.convertToFormat(QImage::Format_RGB888);
+        int size = 0;
+        const double baseline = bestOf3([&]() {
+            QByteArray data;
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::WriteOnly);
+            QImageWriter writer(&buffer, "jpg");
+            writer.setQuality(85);
+            writer.write(rgb);
+            return data;
+        }, &size);
+        out << QString("%1 %2K %3ms").arg(QString("%1 (%2x%3)").arg(sample.first).arg(rgb.width()).arg(rgb.height()).left(28), -28)
+               .arg(size / 1024, 9).arg(baseline, 7, 'f', 1);
+
+        double single = 0;
+        for (int n : threads) {
+            const double ms = bestOf3([&]() { return JpegStripEncoder::encode(rgb, 85, n); }, &size);
+            if (n == 1) single = ms;
+            out << QString("%1K %2ms %3x").arg(size / 1024, 7).arg(ms, 7, 'f', 1).arg(single / ms, 4, 'f', 1);
+        }
+        out << "\n";
+        out.flush();
+    }
+    out << QString("cells: size, best-of-3 encode time, speedup vs 1 thread; idealThreadCount = %1\n").arg(QThread::idealThreadCount());
+}
+
+static QList<QPair<QString, QImage>> loadCorpus(const QStringList& paths)
+{
+    QList<QPair<QString, QImage>> corpus;
+    QStringList files;
+    for (const QString& path : paths) {
+        if (QFileInfo(path).isDir()) {
+            QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) files << it.next();
+        } else {
+            files << path;
+        }
+    }
+    files.sort();
+    for (const QString& file : files) {
+        QImageReader reader(file);
+        const QImage image = reader.read();
+        if (!image.isNull()) corpus << qMakePair(QFileInfo(file).fileName(), image);
+    }
+    return corpus;
+}
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv); // 字体渲染（合成样本）需要
+    QTextStream out(stdout);
+    QStringList args = app.arguments().mid(1);
+    const bool scalingMode = args.removeAll("--scaling") > 0;
+    QList<QPair<QString, QImage>> corpus;
+    if (!args.isEmpty()) {
+        corpus = loadCorpus(args);
+    } else if (scalingMode) {
+        const QImage ui = syntheticCorpus().first().second;
+        corpus << qMakePair(QString("synthetic-4k"), tiledCapture(ui, 3840, 2160));
+        corpus << qMakePair(QString("synthetic-8k"), tiledCapture(ui, 7680, 4320));
+    } else {
+        corpus = syntheticCorpus();
+    }
+    if (corpus.isEmpty()) {
+        out << "no readable images\n";
+        return 1;
+    }
+    if (scalingMode) {
+        scaling(out, corpus);
+        return 0;
+    }
+
+    const QList<Codec> list = codecs();
+    QVector<qint64> totalBytes(list.size());
+    QVector<double> totalMs(list.size());
+    qint64 chosenBytes = 0, chosenMs = 0;
+
+    out << QString("%1 %2 ").arg("sample", -28).arg("kind", -10);
+    for (const Codec& codec : list) out << QString("%1").arg(codec.name, 26);
+    out << "\n";
+
+    for (const auto& sample : corpus) {
+        const QImage& image = sample.second;
+        const ImageCodec::Result chosen = ImageCodec::encode(image);
+        chosenBytes += chosen.data.size();
+        chosenMs += chosen.encodeMs;
+
+        out << QString("%1 %2 ").arg(sample.first.left(28), -28).arg(ImageCodec::kindName(chosen.traits.kind), -10);
+        for (int i = 0; i < list.size(); i++) {
+            const Codec& codec = list[i];
+            QByteArray data;
+            double best = INFINITY;
+            for (int round = 0; round < 3; round++) {
+                QElapsedTimer timer;
+                timer.start();
+                data = ImageCodec::encodeAs(image, codec.format, codec.quality);
+                best = qMin(best, timer.nsecsElapsed() / 1e6);
+            }
+            totalBytes[i] += data.size();
+            totalMs[i] += best;
+            const bool isChoice = codec.name == choiceName(chosen);
+            const double db = psnr(image, data);
+            out << QString("%1%2K %3ms %4")
+                   .arg(isChoice ? "*" : " ", 4)
+                   .arg(data.size() / 1024, 6)
+                   .arg(best, 6, 'f', 1)
+                   .arg(std::isinf(db) ? QString("  inf") : QString::number(db, 'f', 1), 5);
+        }
+        out << "\n";
+    }
+
+    out << QString("%1 %2 ").arg("TOTAL", -28).arg("", -10);
+    for (int i = 0; i < list.size(); i++)
+        out << QString("%1K %2ms").arg(totalBytes[i] / 1024, 14).arg(totalMs[i], 8, 'f', 1);
+    out << "\n";
+    out << QString("selector (*): %1K in %2ms; cells: size, best-of-3 encode time, PSNR dB\n").arg(chosenBytes / 1024).arg(chosenMs);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Compression ratio / time per codec on clipboard samples.
+
+    python tools/compression_bench.py <file or dir> [...]
+
+Feed it real clipboard content (saved logs, source files, JSON dumps,
+screenshots). deflate levels match what WireFormat::deflateLevel picks
+(qCompress uses zlib); zstd and lzma are reported when their Python
+modules are available, as a reference for whether another codec is
+worth negotiating.
+"""
+
+import lzma
+import sys
+import time
+import zlib
+from pathlib import Path
+
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
+THRESHOLD = 1024  # WireFormat::COMPRESS_THRESHOLD
+
+
+def codecs():
+    yield "deflate-1", lambda b: zlib.compress(b, 1)
+    yield "deflate-6", lambda b: zlib.compress(b, 6)
+    yield "deflate-9", lambda b: zlib.compress(b, 9)
+    if zstandard:
+        for level in (1, 3, 9):
+            yield f"zstd-{level}", zstandard.ZstdCompressor(level=level).compress
+    yield "lzma-0", lambda b: lzma.compress(b, preset=0)
+
+
+def samples(paths):
+    for p in map(Path, paths):
+        if p.is_dir():
+            yield from (f for f in sorted(p.rglob("*")) if f.is_file())
+        elif p.is_file():
+            yield p
+
+
+def bench(data, fn, rounds=3):
+    best = float("inf")
+    for _ in range(rounds):
+        t = time.perf_counter()
+        out = fn(data)
+        best = min(best, time.perf_counter() - t)
+    return len(out), best
+
+
+def main():
+    files = list(samples(sys.argv[1:]))
+    if not files:
+        sys.exit(__doc__)
+
+    names = [name for name, _ in codecs()]
+    totals = {name: [0, 0.0] for name in names}
+    raw_total = 0
+    print(f"{'sample':32} {'size':>10}  " + "  ".join(f"{n:>18}" for n in names))
+    for f in files:
+        data = f.read_bytes()
+        if len(data) < THRESHOLD:
+            continue
+        raw_total += len(data)
+        cells = []
+        for name, fn in codecs():
+            size, sec = bench(data, fn)
+            totals[name][0] += size
+            totals[name][1] += sec
+            cells.append(f"{size / len(data):6.3f} {sec * 1000:8.2f}ms")
+        print(f"{f.name[:32]:32} {len(data):>10}  " + "  ".join(f"{c:>18}" for c in cells))
+
+    if raw_total:
+        print(f"{'TOTAL':32} {raw_total:>10}  " + "  ".join(
+            f"{totals[n][0] / raw_total:6.3f} {totals[n][1] * 1000:8.2f}ms" for n in names))
+        print("cells: compressed/raw ratio, best-of-3 compress time")
+
+
+if __name__ == "__main__":
+    main()
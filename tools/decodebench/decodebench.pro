@@ -0,0 +1,28 @@
+QT += core gui widgets network
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# 与客户端共用同一份解码逻辑（WireFormat 依赖 Util / PayloadCipher，只能在 Windows 上构建）
+INCLUDEPATH += ../..
+SOURCES += \
+    ../../payloadcipher.cpp \
+    ../../util.cpp \
+    ../../wireformat.cpp \
+    ../../wirestreamdecoder.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../payloadcipher.h \
+    ../../util.h \
+    ../../webIconFetcher.h \
+    ../../wireformat.h \
+    ../../wirestreamdecoder.h
+
+LIBS += -lbcrypt -lpsapi
+
+msvc {
+    QMAKE_CXXFLAGS += /utf-8
+}
+
+TARGET = decodebench
@@ -0,0 +1,131 @@
+// 下行消息解码的内存峰值：整体解码（收齐响应体 → WireFormat::decode）vs 增量解码（WireStreamDecoder）
+//
+//     decodebench [载荷大小MB，默认1.5]
+//
+// 载荷为随机字节（与 jpg 一样不可压缩），分别编码为 JSON（base64）和二进制帧，写入临时文件
+// stream-cap：解码结果超过1MB后转存到临时文件（Widget 中为 recv/memoryCapMB），峰值不再随载荷增长
+// 每种方式在独立的子进程中运行，按 16KB 分块读取响应体（模拟 readyRead），报告解码期间进程内存峰值的增量：
+// Windows 为 PeakPagefileUsage（私有提交内存），其他平台为 VmHWM（常驻内存）
+
+#include "wireformat.h"
+#include "wirestreamdecoder.h"
+#include <QCoreApplication>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+#include <QTextStream>
+#ifdef Q_OS_WIN
+#include <Windows.h>
+#include <psapi.h>
+#endif
+
+static constexpr int CHUNK = 16 * 1024;
+static constexpr qint64 MEMORY_CAP = 1024 * 1024;
+
+static qint64 peakMemory()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return qint64(counters.PeakPagefileUsage);
+    return 0;
+#else
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly)) return 0;
+    for (const QByteArray& line : status.readAll().split('\n')) {
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+    }
+    return 0;
+#endif
+}
+
+// 子进程：decodebench --child <whole|stream|stream-nolen|stream-cap> <文件> <Content-Type>
+static int child(const QString& mode, const QString& path, const QString& contentType)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return 1;
+    QByteArray chunk(CHUNK, Qt::Uninitialized);
+    const qint64 baseline = peakMemory();
+    QElapsedTimer timer;
+    timer.start();
+
+    ClipPayload payload;
+    bool ok = false;
+    if (mode == "whole") { // 原做法：等 finished 后 readAll，再整体解码
+        QByteArray body;
+        qint64 n;
+        while ((n = file.read(chunk.data(), CHUNK)) > 0)
+            body.append(chunk.constData(), int(n));
+        ok = WireFormat::decode(body, contentType, &payload);
+    } else {
+        WireStreamDecoder decoder(mode == "stream-nolen" ? -1 : file.size(), mode == "stream-cap" ? MEMORY_CAP : 0); // 长轮询带心跳时没有 Content-Length
+        qint64 n;
+        while ((n = file.read(chunk.data(), CHUNK)) > 0)
+            decoder.feed(chunk.constData(), n);
+        ok = decoder.finish(&payload, nullptr);
+    }
+    const qint64 elapsedMs = timer.elapsed();
+    const qint64 size = payload.dataFile.isEmpty() ? payload.data.size() : QFileInfo(payload.dataFile).size();
+    if (!payload.dataFile.isEmpty()) QFile::remove(payload.dataFile);
+    QTextStream(stdout) << (ok ? size : -1) << ' ' << peakMemory() - baseline << ' ' << elapsedMs << '\n';
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments().mid(1);
+    if (args.size() == 4 && args.first() == "--child")
+        return child(args[1], args[2], args[3]);
+
+    QTextStream out(stdout);
+    const double sizeMB = args.isEmpty() ? 1.5 : args.first().toDouble();
+    if (sizeMB <= 0) {
+        out << "usage: decodebench [payload MB]\n";
+        return 1;
+    }
+    QTemporaryDir dir;
+    ClipPayload payload;
+    payload.isText = false;
+    payload.os = "ios";
+    payload.data.resize(int(sizeMB * 1024 * 1024));
+    QRandomGenerator(42).fillRange(reinterpret_cast<quint32*>(payload.data.data()), payload.data.size() / 4);
+
+    struct Body { QString name; QString contentType; QByteArray bytes; };
+    const QList<Body> bodies {
+        {"json", WireFormat::JSON_MIME, WireFormat::encodeJson(payload)},
+        {"binary", WireFormat::BINARY_MIME, WireFormat::encodeBinary(payload)},
+    };
+
+    out << QString("payload %1 MB, %2 KB chunks; peak = process memory high-water mark during decode\n\n")
+           .arg(sizeMB).arg(CHUNK / 1024);
+    out << QString("%1 %2 %3 %4 %5 %6\n").arg("format", -8).arg("mode", -14).arg("body MB", 9)
+           .arg("peak MB", 9).arg("× payload", 10).arg("ms", 6);
+    for (const Body& body : bodies) {
+        const QString path = dir.filePath(body.name);
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(body.bytes) != body.bytes.size()) return 1;
+        file.close();
+
+        for (const QString& mode : {"whole", "stream", "stream-nolen", "stream-cap"}) {
+            if (mode == "stream-nolen" && body.name == "binary") continue; // 帧头自带长度，与 Content-Length 无关
+            QProcess proc;
+            proc.start(app.applicationFilePath(), {"--child", mode, path, body.contentType});
+            proc.waitForFinished(-1);
+            const QList<QByteArray> fields = proc.readAllStandardOutput().trimmed().split(' ');
+            if (proc.exitCode() != 0 || fields.size() != 3 || fields[0].toLongLong() != payload.data.size()) {
+                out << QString("%1 %2 decode failed\n").arg(body.name, -8).arg(mode, -14);
+                continue;
+            }
+            const double peakMB = fields[1].toLongLong() / 1048576.0;
+            out << QString("%1 %2 %3 %4 %5 %6\n").arg(body.name, -8).arg(mode, -14)
+                   .arg(body.bytes.size() / 1048576.0, 9, 'f', 2).arg(peakMB, 9, 'f', 2)
+                   .arg(peakMB / sizeMB, 10, 'f', 2).arg(fields[2].toInt(), 6);
+        }
+    }
+    return 0;
+}
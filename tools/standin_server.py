@@ -0,0 +1,456 @@
+#!/usr/bin/env python3
+"""Local stand-in for Clipboard-Cloud-BE, for comparing push modes of the client.
+
+    python tools/standin_server.py serve [--port 8080] [--no-sse] [--no-binary] [--no-heartbeat] [--no-delta] [--no-mux] [--no-files]
+    python tools/standin_server.py push --id <hashId> [--os ios] [--device <id>] "some text"
+    python tools/standin_server.py push --id <hashId> --file a.pdf [--file b.zip]
+
+Point the client's Server field at http://127.0.0.1:8080.
+Every delivery logs the time from POST arrival to the moment the message
+was written to the Windows side, so long-polling (--no-sse) and SSE can be
+compared side by side. Delta uploads (see deltasync.h) log the bytes saved
+against a full send, with a running total. Several devices can share a channel
+and one connection can subscribe to several channels (/clipboard/mux/*); each
+post fans out to every other device on the channel. Copied files (see
+filetransfer.h) are streamed to a temp file on arrival; only their metadata is
+fanned out, and each device downloads the contents by message id.
+"""
+
+import argparse
+import base64
+import hashlib
+import itertools
+import json
+import os
+import shutil
+import struct
+import tempfile
+import threading
+import time
+import urllib.request
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlsplit
+
+LONG_POLL_TIMEOUT_S = 60
+SSE_KEEPALIVE_S = 15
+MAX_LISTENERS = 2
+MAX_FILES_BYTES = 64 * 1024 * 1024
+COPY_CHUNK = 256 * 1024
+
+BINARY_MIME = "application/octet-stream"
+FRAME_HEADER = struct.Struct(">4sBBHI")  # magic, version, flags, metaLen, payloadLen (see wireformat.h)
+FLAG_TEXT = 0x01
+FLAG_DEFLATE = 0x02
+FLAG_DELTA = 0x04
+FLAG_ENCRYPTED = 0x08
+FLAG_FILES = 0x10
+
+
+def decode_body(body, ctype):
+    """Return {data: bytes, isText: bool, origin: str} from either wire format,
+    plus "base" (SHA-256 hex of the base text) when data is a delta."""
+    if ctype.startswith(BINARY_MIME):
+        magic, version, flags, meta_len, payload_len = FRAME_HEADER.unpack_from(body)
+        if magic != b"DPAW" or version != 1:
+            raise ValueError("bad frame")
+        start = FRAME_HEADER.size + meta_len
+        meta = json.loads(body[FRAME_HEADER.size:start] or b"{}")
+        data = body[start:start + payload_len]
+        msg = {"data": data, "isText": bool(flags & FLAG_TEXT), "origin": meta.get("origin", "")}
+        if flags & FLAG_ENCRYPTED:  # end-to-end encrypted (see payloadcipher.h): opaque, relay as is
+            msg.update(encrypted=True, deflate=bool(flags & FLAG_DEFLATE))
+        elif flags & FLAG_DEFLATE:  # qCompress(): 4-byte big-endian length + zlib stream
+            msg["data"] = zlib.decompress(data[4:])
+        if flags & FLAG_DELTA:
+            msg["base"] = meta.get("base", "")
+        return msg
+    msg = json.loads(body or b"{}")
+    out = {"data": base64.b64decode(msg.get("data", "")), "isText": msg.get("isText", False),
+           "origin": msg.get("origin", "")}
+    if msg.get("encrypted"):
+        out.update(encrypted=True, deflate=bool(msg.get("deflate")))
+    return out
+
+
+def apply_delta(base, delta):
+    """'C' offset:u32 length:u32 copies from base, 'I' length:u32 bytes inserts."""
+    out, pos = bytearray(), 0
+    while pos < len(delta):
+        op = delta[pos:pos + 1]
+        if op == b"C":
+            offset, length = struct.unpack_from(">II", delta, pos + 1)
+            if offset + length > len(base):
+                raise ValueError("copy out of range")
+            out += base[offset:offset + length]
+            pos += 9
+        elif op == b"I":
+            (length,) = struct.unpack_from(">I", delta, pos + 1)
+            out += delta[pos + 5:pos + 5 + length]
+            pos += 5 + length
+        else:
+            raise ValueError("bad delta op")
+    return bytes(out)
+
+
+def base_id(data):
+    return hashlib.sha256(data).hexdigest()
+
+
+def encode_json(msg):
+    return json.dumps(dict(msg, data=base64.b64encode(msg["data"]).decode())).encode()
+
+
+def encode_binary(msg):
+    meta = json.dumps({k: msg[k] for k in ("os", "origin", "channel", "id", "files") if k in msg}).encode()
+    flags = FLAG_TEXT if msg["isText"] else 0
+    if msg.get("encrypted"):
+        flags |= FLAG_ENCRYPTED | (FLAG_DEFLATE if msg.get("deflate") else 0)
+    if msg.get("files"):  # metadata only, the contents are fetched from /clipboard/files/{hashId}/{id}
+        flags |= FLAG_FILES
+    return FRAME_HEADER.pack(b"DPAW", 1, flags, len(meta), len(msg["data"])) + meta + msg["data"]
+
+
+class Hub:
+    """Per-device mailboxes: a message posted to a channel is fanned out to every
+    other device subscribed to it, and removed from a mailbox once delivered.
+
+    Legacy routes (/{hashId}/{os}) act as the device "legacy:{hashId}:{os}"; a post
+    always queues for the legacy counterpart (win <-> ios) like the old server did.
+    """
+
+    def __init__(self):
+        self.cond = threading.Condition()
+        self.channels = {}  # device -> subscribed channels
+        self.pending = {}  # device -> {channel: (message dict, arrival time)}, latest per channel
+        self.consumers = {}  # device -> tokens of the newest listeners
+        self.ids = itertools.count(1)
+        self.bases = {}  # (hashId, origin) -> last text posted, the base for the next delta
+        self.delta_stats = [0, 0]  # bytes received as deltas, bytes they expanded to
+        self.files = {}  # (hashId, message id) -> temp file holding the concatenated contents
+
+    def subscribe(self, device, channels):
+        """Only the newest MAX_LISTENERS listeners stay live, so a half-dead old
+        connection can't swallow messages (overlapped long-polls use two)."""
+        with self.cond:
+            self.channels.setdefault(device, set()).update(channels)
+            token = object()
+            tokens = self.consumers.setdefault(device, [])
+            tokens.append(token)
+            del tokens[:-MAX_LISTENERS]
+            self.cond.notify_all()
+            return token
+
+    def is_live(self, device, token):
+        return token in self.consumers.get(device, [])
+
+    def post(self, channel, src_os, origin, msg, skip=()):
+        msg = dict(msg, os=src_os, origin=origin, channel=channel, id=str(next(self.ids)))
+        arrived = time.monotonic()
+        with self.cond:
+            counterpart = f"legacy:{channel}:{'ios' if src_os != 'ios' else 'win'}"
+            self.channels.setdefault(counterpart, set()).add(channel)
+            targets = [d for d, chans in self.channels.items() if channel in chans and d != origin and d not in skip]
+            for device in targets:
+                self.pending.setdefault(device, {})[channel] = (msg, arrived)
+            self.cond.notify_all()
+        return len(targets), msg["id"]
+
+    def take(self, device, timeout, token=None):
+        deadline = time.monotonic() + timeout
+        with self.cond:
+            while not self.pending.get(device):
+                if token is not None and not self.is_live(device, token):
+                    return None, None
+                left = deadline - time.monotonic()
+                if left <= 0:
+                    return None, None
+                self.cond.wait(left)
+            box = self.pending[device]
+            channel = min(box, key=lambda c: box[c][1])  # oldest first
+            return box.pop(channel)
+
+
+HUB = Hub()
+SSE_ENABLED = True
+BINARY_ENABLED = True
+HEARTBEAT_ENABLED = True
+DELTA_ENABLED = True
+MUX_ENABLED = True
+FILES_ENABLED = True
+
+
+def log_delivery(mode, msg, arrived):
+    delay_ms = (time.monotonic() - arrived) * 1000
+    print(f"[{mode}] delivered {len(msg['data'])} B after {delay_ms:.1f} ms", flush=True)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        print("%s - %s" % (self.address_string(), fmt % args), flush=True)
+
+    def parts(self):
+        return [p for p in self.path.split("?")[0].split("/") if p]
+
+    def subscriber(self, p):
+        """(device, channels) for /clipboard/mux/<route>?device=&channels= or /clipboard/<route>/<hashId>/<os>."""
+        if p[1] == "mux":
+            query = parse_qs(urlsplit(self.path).query)
+            return query.get("device", [""])[0], [c for c in query.get("channels", [""])[0].split(",") if c]
+        return f"legacy:{p[2]}:{p[3]}", [p[2]]
+
+    def reply(self, code, body=b"", ctype="application/json", headers=None):
+        self.send_response(code)
+        self.send_header("Content-Type", ctype)
+        self.send_header("Content-Length", str(len(body)))
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        if BINARY_ENABLED:
+            self.send_header("Accept-Post", f"{BINARY_MIME}, application/json")
+            self.send_header("Accept-Encoding", "deflate")
+        self.end_headers()
+        if body and self.command != "HEAD":
+            self.wfile.write(body)
+
+    def do_HEAD(self):
+        self.do_GET()
+
+    def do_GET(self):
+        p = self.parts()
+        if p == ["test"]:
+            return self.reply(200, b"ok", "text/plain")
+        if FILES_ENABLED and len(p) == 4 and p[:2] == ["clipboard", "files"]:
+            return self.serve_files(p[2], p[3])
+        mux = MUX_ENABLED and len(p) == 3 and p[:2] == ["clipboard", "mux"]
+        if mux and p[2] == "long-polling" or len(p) == 4 and p[:2] == ["clipboard", "long-polling"]:
+            device, channels = self.subscriber(p)
+            if not device or not channels:
+                return self.reply(400, b"device and channels required", "text/plain")
+            if self.heartbeat():
+                return self.serve_long_poll_with_heartbeat(device, channels)
+            token = HUB.subscribe(device, channels)
+            msg, arrived = HUB.take(device, LONG_POLL_TIMEOUT_S, token)
+            if msg is None:
+                return self.reply(204)
+            log_delivery("long-polling", msg, arrived)
+            return self.reply(200, *self.encode_for_client(msg))
+        if mux and p[2] == "sse" or len(p) == 4 and p[:2] == ["clipboard", "sse"]:
+            if not SSE_ENABLED:
+                return self.reply(404, b"not found", "text/plain")
+            device, channels = self.subscriber(p)
+            if not device or not channels:
+                return self.reply(400, b"device and channels required", "text/plain")
+            return self.serve_sse(device, channels)
+        if len(p) == 3 and p[0] == "clipboard" and p[1] != "mux":
+            device = f"legacy:{p[1]}:{p[2]}"
+            HUB.subscribe(device, [p[1]])
+            msg, _ = HUB.take(device, 0)
+            return self.reply(200, encode_json(msg) if msg else b"{}")
+        self.reply(404, b"not found", "text/plain")
+
+    def heartbeat(self):
+        return HEARTBEAT_ENABLED and int(self.headers.get("X-Heartbeat-Interval", 0)) or 0
+
+    def encode_for_client(self, msg):
+        if BINARY_ENABLED and BINARY_MIME in self.headers.get("Accept", ""):
+            return encode_binary(msg), BINARY_MIME
+        return encode_json(msg), "application/json"
+
+    def serve_long_poll_with_heartbeat(self, device, channels):
+        """Headers go out at once, then a space per interval until a message arrives."""
+        msg = None
+        token = HUB.subscribe(device, channels)
+        self.send_response(200)
+        self.send_header("Content-Type", BINARY_MIME if BINARY_ENABLED and BINARY_MIME in self.headers.get("Accept", "")
+                         else "application/json")
+        self.send_header("Connection", "close")
+        self.end_headers()
+        self.close_connection = True
+        try:
+            deadline = time.monotonic() + LONG_POLL_TIMEOUT_S
+            while time.monotonic() < deadline:
+                msg, arrived = HUB.take(device, self.heartbeat(), token)
+                if msg is not None:
+                    self.wfile.write(self.encode_for_client(msg)[0])
+                    log_delivery("long-polling", msg, arrived)
+                    break
+                if not HUB.is_live(device, token):
+                    break
+                self.wfile.write(b" ")
+                self.wfile.flush()
+        except (BrokenPipeError, ConnectionResetError):
+            pass
+
+    def do_POST(self):
+        p = self.parts()
+        if FILES_ENABLED and len(p) == 4 and p[:2] == ["clipboard", "files"]:
+            return self.receive_files(p[2], p[3])
+        if len(p) != 3 or p[0] != "clipboard":
+            return self.reply(404, b"not found", "text/plain")
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        ctype = self.headers.get("Content-Type", "")
+        if ctype.startswith(BINARY_MIME) and not BINARY_ENABLED:
+            return self.reply(415, b"unsupported media type", "text/plain")
+        msg = decode_body(body, ctype)
+        origin = msg.pop("origin", "") or f"legacy:{p[1]}:{p[2]}"
+        key = (p[1], origin)
+        if "base" in msg:
+            base = HUB.bases.get(key)
+            if not DELTA_ENABLED or base is None or base_id(base) != msg.pop("base"):
+                print("[post] delta base unknown, 412", flush=True)
+                return self.reply(412, b"delta base unknown", "text/plain")
+            delta_len = len(msg["data"])
+            msg["data"] = apply_delta(base, msg["data"])
+            stats = HUB.delta_stats
+            stats[0] += len(body)
+            stats[1] += len(msg["data"])
+            print(f"[delta] {len(body)} B on the wire for {len(msg['data'])} B text ({delta_len} B ops), "
+                  f"saved {100 - len(body) * 100 / max(1, len(msg['data'])):.1f}%; "
+                  f"total {stats[0]} B instead of {stats[1]} B", flush=True)
+        # devices the client already reached over its LAN direct path (see lanpeer.h)
+        skip = [d for d in self.headers.get("X-Delivered-To", "").split(",") if d]
+        fanout, _ = HUB.post(p[1], p[2], origin, msg, skip)
+        print(f"[post] {len(body)} B on the wire, {len(msg['data'])} B payload from {origin}, "
+              f"fanned out to {fanout} device(s)" + (f", {len(skip)} already reached over LAN" if skip else ""), flush=True)
+        headers = {}
+        if msg["isText"] and not msg.get("encrypted") and DELTA_ENABLED and BINARY_ENABLED:
+            HUB.bases[key] = msg["data"]
+            headers["X-Delta-Base"] = base_id(msg["data"])
+        else:
+            HUB.bases.pop(key, None)
+        self.reply(200, b"{}", headers=headers)
+
+    def receive_files(self, channel, src_os):
+        """Header + meta (files: [{name, size}]), then the contents back to back, copied to disk as they arrive."""
+        length = int(self.headers.get("Content-Length", 0))
+        head = self.rfile.read(FRAME_HEADER.size)
+        magic, version, flags, meta_len, payload_len = FRAME_HEADER.unpack(head)
+        meta = json.loads(self.rfile.read(meta_len) or b"{}")
+        files = meta.get("files", [])
+        if magic != b"DPAW" or not flags & FLAG_FILES or not files or sum(f["size"] for f in files) != payload_len \
+                or FRAME_HEADER.size + meta_len + payload_len != length:
+            self.close_connection = True
+            return self.reply(400, b"bad file frame", "text/plain")
+        if payload_len > MAX_FILES_BYTES:
+            self.close_connection = True  # the body is left unread
+            return self.reply(413, b"files too large", "text/plain")
+        arrived = time.monotonic()
+        with tempfile.NamedTemporaryFile(prefix="dogpaw-", delete=False) as out:
+            left = payload_len
+            while left:
+                chunk = self.rfile.read(min(COPY_CHUNK, left))
+                if not chunk:
+                    out.close()
+                    os.remove(out.name)
+                    return
+                out.write(chunk)
+                left -= len(chunk)
+        origin = meta.get("origin", "") or f"legacy:{channel}:{src_os}"
+        msg = {"data": b"", "isText": False, "files": [{"name": f["name"], "size": f["size"]} for f in files]}
+        fanout, msg_id = HUB.post(channel, src_os, origin, msg)
+        HUB.files[(channel, msg_id)] = out.name
+        print(f"[files] {len(files)} file(s), {payload_len} B from {origin} in "
+              f"{(time.monotonic() - arrived) * 1000:.0f} ms, fanned out to {fanout} device(s)", flush=True)
+        self.reply(200, b"{}")
+
+    def serve_files(self, channel, msg_id):
+        path = HUB.files.get((channel, msg_id))
+        if not path:
+            return self.reply(404, b"not found", "text/plain")
+        self.send_response(200)
+        self.send_header("Content-Type", BINARY_MIME)
+        self.send_header("Content-Length", str(os.path.getsize(path)))
+        self.end_headers()
+        if self.command == "HEAD":
+            return
+        with open(path, "rb") as f:
+            shutil.copyfileobj(f, self.wfile, COPY_CHUNK)
+
+    def serve_sse(self, device, channels):
+        self.send_response(200)
+        self.send_header("Content-Type", "text/event-stream")
+        self.send_header("Cache-Control", "no-cache")
+        self.end_headers()
+        self.close_connection = True
+        token = HUB.subscribe(device, channels)
+        try:
+            self.wfile.write(b": connected\n\n")
+            self.wfile.flush()
+            while True:
+                msg, arrived = HUB.take(device, self.heartbeat() or SSE_KEEPALIVE_S, token)
+                if msg is None and not HUB.is_live(device, token):
+                    break  # superseded by a newer connection
+                if msg is None:
+                    self.wfile.write(b": keep-alive\n\n")
+                else:
+                    self.wfile.write(b"data: " + encode_json(msg) + b"\n\n")
+                    log_delivery("sse", msg, arrived)
+                self.wfile.flush()
+        except (BrokenPipeError, ConnectionResetError):
+            pass
+
+
+def push(args):
+    if args.file:
+        files = [{"name": os.path.basename(path), "size": os.path.getsize(path)} for path in args.file]
+        meta = {"files": files, "origin": args.device} if args.device else {"files": files}
+        meta = json.dumps(meta).encode()
+        body = FRAME_HEADER.pack(b"DPAW", 1, FLAG_FILES, len(meta), sum(f["size"] for f in files)) + meta
+        for path in args.file:
+            with open(path, "rb") as f:
+                body += f.read()
+        req = urllib.request.Request(f"{args.server}/clipboard/files/{args.id}/{args.os}", data=body,
+                                     headers={"Content-Type": BINARY_MIME})
+        with urllib.request.urlopen(req) as resp:
+            return print(resp.status)
+    msg = {"data": args.text.encode(), "isText": True}
+    if args.device:
+        msg["origin"] = args.device
+    body = encode_json(msg)
+    req = urllib.request.Request(f"{args.server}/clipboard/{args.id}/{args.os}", data=body,
+                                 headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(req) as resp:
+        print(resp.status)
+
+
+def main():
+    global SSE_ENABLED, BINARY_ENABLED, HEARTBEAT_ENABLED, DELTA_ENABLED, MUX_ENABLED, FILES_ENABLED
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    serve = sub.add_parser("serve")
+    serve.add_argument("--port", type=int, default=8080)
+    serve.add_argument("--no-sse", action="store_true", help="answer 404 on the SSE route (long-polling only)")
+    serve.add_argument("--no-heartbeat", action="store_true", help="ignore X-Heartbeat-Interval (old server)")
+    serve.add_argument("--no-binary", action="store_true", help="JSON wire format only (answer 415 to binary posts)")
+    serve.add_argument("--no-delta", action="store_true", help="never confirm a delta base (full uploads only)")
+    serve.add_argument("--no-mux", action="store_true", help="answer 404 on /clipboard/mux/* (old server)")
+    serve.add_argument("--no-files", action="store_true", help="answer 404 on /clipboard/files/* (old server)")
+
+    p = sub.add_parser("push", help="post a text message as the iOS side (or any other device)")
+    p.add_argument("--server", default="http://127.0.0.1:8080")
+    p.add_argument("--id", required=True, help="channel (hashId)")
+    p.add_argument("--os", default="ios")
+    p.add_argument("--device", default="", help="origin device id (default: legacy device for --os)")
+    p.add_argument("--file", action="append", help="post these files instead of text (repeatable)")
+    p.add_argument("text", nargs="?", default="")
+
+    args = parser.parse_args()
+    if args.cmd == "push":
+        return push(args)
+
+    SSE_ENABLED = not args.no_sse
+    BINARY_ENABLED = not args.no_binary
+    HEARTBEAT_ENABLED = not args.no_heartbeat
+    DELTA_ENABLED = not args.no_delta
+    MUX_ENABLED = not args.no_mux
+    FILES_ENABLED = not args.no_files
+    print(f"stand-in server on :{args.port}, SSE {'on' if SSE_ENABLED else 'off'}, "
+          f"binary {'on' if BINARY_ENABLED else 'off'}", flush=True)
+    ThreadingHTTPServer(("127.0.0.1", args.port), Handler).serve_forever()
+
+
+if __name__ == "__main__":
+    main()
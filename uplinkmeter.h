@@ -0,0 +1,32 @@
+#ifndef UPLINKMETER_H
+#define UPLINKMETER_H
+
+#include <QtGlobal>
+
+// 上行带宽估计：用成功上传的 字节数 / 耗时 做滑动平均
+// 耗时包含往返延迟，小数据主要在测延迟，不计入
+// 用于确定图像的字节预算：预计传输时间不超过目标值（慢速网络下宁可缩小图片，也不要等到超时）
+class UplinkMeter {
+public:
+    static constexpr qint64 MIN_SAMPLE_BYTES = 64 * 1024;
+
+    void record(qint64 bytes, qint64 ms) {
+        if (bytes < MIN_SAMPLE_BYTES) return;
+        const double sample = bytes * 1000.0 / qMax<qint64>(ms, 1);
+        rate = rate <= 0 ? sample : rate * 0.7 + sample * 0.3;
+    }
+
+    bool isKnown() const { return rate > 0; }
+    double bytesPerSec() const { return rate; }
+
+    // 预计 targetMs 内能传完的字节数，不低于 floorBytes；带宽未知时不限制
+    int budgetBytes(int targetMs, int floorBytes, int capBytes) const {
+        if (!isKnown()) return capBytes;
+        return int(qBound<double>(floorBytes, rate * targetMs / 1000.0, capBytes));
+    }
+
+private:
+    double rate = 0; // bytes/s，0 表示未知
+};
+
+#endif // UPLINKMETER_H
@@ -0,0 +1,62 @@
+#include "uploadqueue.h"
+#include <QDebug>
+
+UploadQueue::UploadQueue(Sender sender, QObject* parent)
+    : QObject(parent)
+    , sender(std::move(sender))
+{
+}
+
+void UploadQueue::submit(const ClipPayload& payload)
+{
+    if (hasPending) {
+        superseded++;
+        qDebug() << "Upload superseded before sending. total:" << superseded;
+    }
+    pending = payload;
+    hasPending = true;
+
+    if (active && !activeIsSmall) {
+        superseded++;
+        qDebug() << "Abort superseded in-flight upload. total:" << superseded;
+        QNetworkReply* old = active;
+        active = nullptr;
+        old->setProperty("superseded", true); // Widget据此不提示失败
+        old->abort(); // 同步触发finished
+    }
+
+    if (!active)
+        startNext();
+}
+
+bool UploadQueue::isSmall(const ClipPayload& payload)
+{
+    return payload.isText && payload.data.size() <= SMALL_TEXT_LIMIT;
+}
+
+void UploadQueue::startNext()
+{
+    if (!hasPending) return;
+    const ClipPayload payload = pending;
+    pending = ClipPayload();
+    hasPending = false;
+
+    if (QNetworkReply* reply = sender(payload))
+        track(reply, isSmall(payload));
+}
+
+void UploadQueue::track(QNetworkReply* reply, bool small)
+{
+    active = reply;
+    activeIsSmall = small;
+    connect(reply, &QNetworkReply::finished, this, [=]() {
+        if (reply != active) return; // 已被中止替换
+        // 发送方可能在 finished 中重试（如二进制格式被拒绝），继续跟踪新的请求
+        if (auto retry = qobject_cast<QNetworkReply*>(reply->property("retryReply").value<QObject*>())) {
+            track(retry, small);
+            return;
+        }
+        active = nullptr;
+        startNext();
+    });
+}
@@ -0,0 +1,47 @@
+#ifndef UPLOADQUEUE_H
+#define UPLOADQUEUE_H
+
+#include <QObject>
+#include <QNetworkReply>
+#include <QPointer>
+#include <functional>
+#include "wireformat.h"
+
+// 上传调度（全局一个，不分频道）：同一时间只有一个上传，最新的剪贴板状态优先
+// 本机只向主频道（hashId）发送，附加频道只订阅（见 Widget::subscribedChannels），不会互相中止；
+// 若以后允许向多个频道发送，需要按频道各建一个
+// - 新数据到来时，旧的待发送数据直接丢弃（latest-wins）
+// - 正在上传的大数据（图像 / 大文本）会被中止，避免它晚于新数据到达而覆盖服务端内容，浪费上行带宽
+// - 正在上传的小文本很快就能完成，不中止，完成后立即发送最新数据（保证顺序）
+class UploadQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 返回 nullptr 表示数据被拒绝（如过大），不会占用上传位
+    using Sender = std::function<QNetworkReply*(const ClipPayload& payload)>;
+
+    explicit UploadQueue(Sender sender, QObject* parent = nullptr);
+
+    void submit(const ClipPayload& payload);
+    bool isBusy(void) const { return !active.isNull(); }
+    quint64 supersededCount(void) const { return superseded; }
+
+    static bool isSmall(const ClipPayload& payload); // 小文本走优先通道
+
+private:
+    void startNext(void);
+    void track(QNetworkReply* reply, bool small);
+
+private:
+    Sender sender;
+    QPointer<QNetworkReply> active;
+    bool activeIsSmall = false;
+    ClipPayload pending;
+    bool hasPending = false;
+    quint64 superseded = 0;
+
+    static constexpr int SMALL_TEXT_LIMIT = 64 * 1024;
+};
+
+#endif // UPLOADQUEUE_H
@@ -14,15 +14,19 @@ private:
 
 public:
     // 根据数据量，转化为以合适的单位 (B, KB, MB, GB)，返回String
-    static QString printDataSize(int bytes);
+    static QString printDataSize(qint64 bytes);
     static QString genSHA256(const QString& str);
 
     static QString appPath(void);
     static void setAutoRun(const QString& appName, bool autoRun);
     static bool isAutoRun(const QString& appName);
 
-    static QByteArray clipboardData(bool* isText = nullptr);
+    // 内容指纹，用于合并重复事件、去重
+    static quint64 fingerprint(const void* data, size_t size);
     static QString genUUID(void);
+    // DPAPI（CryptProtectData）：只有当前 Windows 用户能解密，用于落盘的敏感数据；失败返回空
+    static QByteArray protectData(const QByteArray& data);
+    static QByteArray unprotectData(const QByteArray& data);
 
     static void openExplorerAndSelectFile(const QString& filePath);
     static QString saveImageToTemp(const QImage& image, const char *format = nullptr);
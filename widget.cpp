@@ -3,21 +3,31 @@
 #include "util.h"
 #include <QClipboard>
 #include <QMimeData>
-#include <QJsonObject>
-#include <QJsonDocument>
 #include <QNetworkReply>
 #include <QBuffer>
 #include <QRcode/QRUtil.h>
 #include <QTimer>
 #include <QSettings>
+#include <QDateTime>
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
 #include <QMessageBox>
 #include <QMenu>
 #include <QCloseEvent>
 #include "wintoastlib.h"
 #include "toastHandler.h"
+#include "pushchannel.h"
+#include "wireformat.h"
+#include "uploadqueue.h"
+#include "outboxjournal.h"
+#include "lanpeer.h"
+#include "payloadcipher.h"
+#include "filetransfer.h"
+#include "deferredmimedata.h"
 #include <QDesktopServices>
 #include <QFileDialog>
+#include <QScopeGuard>
 
 Widget::Widget(QWidget *parent)
     : QWidget(parent)
@@ -64,13 +74,13 @@ Widget::Widget(QWidget *parent)
         this->uuid = ui->edit_uuid->text();
         this->hashId = genHashID();
 
-        if (pollingReply) {
-            qDebug() << "Settings changed, abort old polling.";
-            pollingReply->abort(); // stop old polling & start new automatically
-            pollingReply = nullptr;
-        }
-
         writeSettings();
+        if (isAppReady) {
+            qDebug() << "Settings changed, restart push channel.";
+            updateCipher(); // 密钥随 uuid & userId 变化
+            pushChannel->start(baseUrl, subscribedChannels(), deviceId);
+            if (lanEnabled) lanPeer->start(hashId, LanPeer::deriveSecret(uuid, userId), deviceId);
+        }
         emit appReady();// save to ready while initSettings()
 
         // show saved animation, to indicate the user
@@ -82,22 +92,63 @@ Widget::Widget(QWidget *parent)
     //更新连接状态（UI显示）
     //每个请求结束都会触发
     connect(manager, &QNetworkAccessManager::finished, this, [=](QNetworkReply* reply){
-        updateConnectionStatus(reply->error() == QNetworkReply::NoError);
+        // SSE探测失败会降级、被取代的上传是主动中止，都不算断线
+        if (!reply->property("probe").toBool() && !reply->property("superseded").toBool())
+            updateConnectionStatus(reply->error() == QNetworkReply::NoError);
+        if (reply->error() == QNetworkReply::NoError)
+            saveTlsSession(reply);
+        if (!binaryWire && reply->rawHeader("Accept-Post").contains(WireFormat::BINARY_MIME)) {
+            qDebug() << "Server supports binary wire format.";
+            binaryWire = true;
+        }
+        if (!deflateWire && reply->rawHeader("Accept-Encoding").contains("deflate")) {
+            qDebug() << "Server accepts deflate payloads.";
+            deflateWire = true;
+        }
         reply->deleteLater();
     });
 
+    this->pushChannel = new PushChannel(manager, this);
+    pushChannel->setHeartbeat(heartbeatMs, livenessMs);
+    pushChannel->setStandbyPoll(standbyPoll);
+    pushChannel->setMemoryCap(qint64(recvMemoryCapMB) * 1024 * 1024);
+    connect(pushChannel, &PushChannel::payloadReceived, this, &Widget::handleCloudMessage);
+    connect(pushChannel, &PushChannel::stateChanged, this, [=](PushChannel::State state, int retryDelayMs) {
+        if (state == PushChannel::Connecting) return; // 结果未知，保持原状态
+        if (state == PushChannel::Connected) { // 恢复连接，重发离线期间失败的数据
+            outbox->takeLatest(hashId, [=](const ClipPayload& payload) {
+                if (uploadQueue->isBusy()) return false; // 已经有更新的数据在上传，其结果决定旧数据的去留
+                qDebug() << "Outbox: replay failed post.";
+                uploadQueue->submit(payload);
+                return true;
+            });
+        }
+        updateConnectionStatus(state == PushChannel::Connected);
+        if (state == PushChannel::Backoff)
+            sysTray->setToolTip(QString("%1 - [Disconnected]\nretry #%2 in %3s\n[click to Post]")
+                                .arg(APP_NAME).arg(pushChannel->backoff().attemptCount()).arg(retryDelayMs / 1000.0, 0, 'f', 1));
+    });
+    this->capturePipeline = new CapturePipeline(this);
+    this->receivePipeline = new ReceivePipeline(this);
+    this->lanPeer = new LanPeer(this);
+    connect(lanPeer, &LanPeer::payloadReceived, this, &Widget::handleLanMessage);
+    this->uploadQueue = new UploadQueue([=](const ClipPayload& payload) { return postPayload(payload); }, this);
+    this->outbox = new OutboxJournal(qApp->applicationDirPath() + "/outbox.journal", this);
+
     //监听剪贴板变化
     //sth.:hexo博客界面 代码块右上角的复制按钮，为什么会产生17次同样数据的剪切板修改, not my problem
-    //TODO: 浏览器复制URL会触发三次（应该是浏览器问题？）
-    //TODO: lastTime 限制频率，避免重复上传，但是不能只判断内容，只要不是短时间高频率的重复，都应该上传，才符合直觉
+    //浏览器复制URL会触发三次（应该是浏览器问题？）
+    //所以用 ClipCoalescer 合并：短时间高频率的相同内容只上传一次，窗口过后的重复复制仍然上传，才符合直觉
     connect(qApp->clipboard(), &QClipboard::dataChanged, this, [=](){
-        if (recvOnly) return;
         if (isMeSetClipboard) { // 避免检测到自身对剪切板的修改
             qDebug() << "Info: Me set clipboard, ignore.";
             isMeSetClipboard = false;
             return;
         }
-        postClipboard();
+        receivePipeline->cancel(); // 用户复制了新内容，还在解码的收到的图像不能再覆盖它（仅接收模式同样如此）
+        ++clipGeneration; // 下载中的文件同理
+        if (recvOnly) return;
+        postClipboard(true); // 指纹在流水线中计算，结果返回后再合并
     });
 
     // after: readSettings or save
@@ -106,7 +157,11 @@ Widget::Widget(QWidget *parent)
         this->isAppReady = true;
 
         sysTray->showMessage("App Ready", "Connecting Server...");
-        pollCloudClip(); //发起长轮询，以获取实时推送
+        updateCipher();
+        restoreTlsSession();
+        prewarmConnection(); //提前完成TLS握手，登录后的第一次 Ctrl+C 无需等待
+        pushChannel->start(baseUrl, subscribedChannels(), deviceId); //建立推送通道（SSE / 长轮询），以获取实时推送
+        if (lanEnabled) lanPeer->start(hashId, LanPeer::deriveSecret(uuid, userId), deviceId); //局域网发现 & 直连
     });
 
     initWinToast(APP_NAME, "Aliaba");
@@ -117,39 +172,112 @@ Widget::~Widget()
     delete ui;
 }
 
-void Widget::postClipboard()
+void Widget::postClipboard(bool coalesce)
 {
     if (!isAppReady) {
         sysTray->showMessage("WARN", "App not ready.", QSystemTrayIcon::Warning);
         return;
     }
+    receivePipeline->cancel(); // 手动发送当前剪贴板：之后完成的收到的图像 / 文件不再覆盖它
+    ++clipGeneration;
 
-    bool isText;
-    // 1.图像进行 Base64 编码，防止老式设备进行隐式编解码导致信息丢失
-    // 2.文本也进行 BASE64 编码，防止外链明文泄露，造成言论安全问题
-    QByteArray data = Util::clipboardData(&isText).toBase64();
-    if (data.isEmpty()) {
+    // GUI线程只抓取剪贴板内容，转换、编码、哈希都在线程池中进行
+    const ClipSnapshot snapshot = CapturePipeline::grab();
+    if (snapshot.isEmpty()) {
         sysTray->showMessage("WARN", "Clipboard data is empty.");
         return;
     }
 
-    if (data.size() > 1024 * 1024 * 2) { // 2MB
+    ClipPayload meta;
+    meta.os = "win";
+    meta.origin = deviceId;
+    // 图像字节预算：按实测上行带宽，预计传输时间不超过 TARGET_UPLOAD_MS（带宽未知时只受请求体上限限制）
+    ImageCodec::Budget budget;
+    budget.maxBytes = uplink.budgetBytes(TARGET_UPLOAD_MS, MIN_IMAGE_BUDGET, WireFormat::MAX_BODY);
+    if (uplink.isKnown())
+        qDebug() << "Uplink ≈" << Util::printDataSize(int(uplink.bytesPerSec())) + "/s, image budget:" << Util::printDataSize(budget.maxBytes);
+
+    // 每个事件都取指纹并按顺序合并（计数、窗口都以事件为准），只有通过的才进入 latest-wins 的编码
+    const qint64 eventMs = clipCoalescer.now();
+    capturePipeline->fingerprint(snapshot, [=](const ClipSnapshot& hashed) {
+        if (coalesce && !clipCoalescer.accept(hashed.fingerprint, eventMs)) {
+            qDebug() << "Info: Duplicate clipboard event, coalesced. total suppressed:" << clipCoalescer.suppressedCount();
+            return;
+        }
+        capturePipeline->submit(hashed, meta, wireOptions(), budget, [=](const ClipPayload& payload, quint64 fingerprint, const QString& reduction) {
+            onCaptured(payload, fingerprint, reduction, coalesce);
+        });
+    });
+}
+
+void Widget::onCaptured(const ClipPayload& payload, quint64 fingerprint, const QString& reduction, bool coalesce)
+{
+    EncodeCache& cache = capturePipeline->encodeCache();
+    if (coalesce && cache.isUploaded(fingerprint)) { // 服务端的最新值就是它（如剪贴板管理器重新声明所有权），手动 Post 除外
+        qDebug() << "Info: Identical to the last acknowledged upload, skipped.";
+        return;
+    }
+    cache.clearUploaded(); // 服务端的最新值即将改变；上传失败进入发件箱时也不能再认为它是最新的
+    if (!reduction.isEmpty()) // 以前超出2MB直接丢弃，现在发送缩减版本，需要让用户知道
+        sysTray->showMessage("Image reduced", "Sent a reduced version to fit the upload limit:\n" + reduction);
+    sendPayload(payload);
+}
+
+void Widget::sendPayload(const ClipPayload& payload)
+{
+    const quint64 seq = ++sendSeq;
+    if (lanPeer->hasPeers() && payload.files.isEmpty()) { // 局域网内的设备直连送达（文件只走云端）（毫秒级），云端仍要上传给其他设备（如iOS），但跳过已送达的
+        lanPeer->send(payload, [=](const QStringList& delivered) {
+            if (seq != sendSeq) { // 对端响应慢 / 超时期间已有更新的数据进入上传队列，再上传旧数据会覆盖它（latest-wins）
+                qDebug() << "Info: LAN send superseded, skip cloud upload.";
+                return;
+            }
+            ClipPayload cloud = payload;
+            cloud.deliveredTo = delivered;
+            uploadQueue->submit(cloud);
+        });
+        return;
+    }
+    uploadQueue->submit(payload);
+}
+
+CapturePipeline::WireOptions Widget::wireOptions() const
+{
+    CapturePipeline::WireOptions options;
+    options.binary = binaryWire;
+    options.deflate = deflateWire;
+    options.cipher = cipher;
+    return options;
+}
+
+QNetworkReply* Widget::postPayload(const ClipPayload& payload)
+{
+    if (!payload.files.isEmpty()) return postFiles(payload);
+
+    // 服务端支持时使用二进制帧，避免 base64 膨胀33% & JSON 多次整体拷贝
+    const bool binary = binaryWire;
+    // 大文本只发送与服务端已确认的上一版之间的差异；payload 本身保持完整，用于重试和离线发件箱
+    ClipPayload wire = payload;
+    // 加密后服务端无法还原增量，两者互斥
+    const bool delta = binary && !cipher && deltaSync.makeDelta(hashId, payload, &wire);
+    QByteArray postData;
+    if (!delta && !payload.wire.isEmpty() && payload.wireKey == wireOptions().key()) // 流水线已预编码
+        postData = payload.wire;
+    else
+        postData = binary ? WireFormat::encodeBinary(wire, deflateWire, cipher.data()) : WireFormat::encodeJson(payload, cipher.data());
+
+    if (postData.size() > WireFormat::MAX_BODY) { // 2MB
         qWarning() << "WARN: Data too large, ignore.";
         sysTray->showMessage("WARN", "Data too large, ignore.");
-        return;
+        return nullptr;
     }
 
-    QNetworkRequest request(QUrl(QString("%1/clipboard/%2/win").arg(baseUrl, hashId)));
+    QNetworkRequest request(QUrl(QString("%1/clipboard/%2/%3").arg(baseUrl, hashId, payload.os)));
     // 超时会abort()，同时触发finished信号，并产生QNetworkReply::OperationCanceledError 状态码为0
     request.setTransferTimeout(8 * 1000); // 8s超时时间
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-
-    QJsonObject jsonData;
-    jsonData.insert("data", QString::fromUtf8(data));
-    jsonData.insert("isText", isText);
-
-    QJsonDocument doc(jsonData);
-    QByteArray postData = doc.toJson();
+    request.setHeader(QNetworkRequest::ContentTypeHeader, binary ? WireFormat::BINARY_MIME : WireFormat::JSON_MIME);
+    if (!payload.deliveredTo.isEmpty()) // 服务端扇出时跳过这些设备
+        request.setRawHeader("X-Delivered-To", payload.deliveredTo.join(',').toUtf8());
 
     QTime start = QTime::currentTime();
     QNetworkReply *reply = manager->post(request, postData);
@@ -157,108 +285,318 @@ void Widget::postClipboard()
 
     QObject::connect(reply, &QNetworkReply::finished, this, [=]() {
         int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (reply->property("superseded").toBool()) { // 被更新的剪贴板数据取代，不算失败
+            qDebug() << "↑Upload superseded by newer clipboard data.";
+            reply->deleteLater();
+            return;
+        }
+        if (binary && statusCode == 415) { // Unsupported Media Type：服务端不认识二进制帧，降级为JSON重发
+            qWarning() << "WARN: Binary wire format rejected, fallback to JSON.";
+            binaryWire = false;
+            reply->setProperty("retryReply", QVariant::fromValue<QObject*>(postPayload(payload))); // UploadQueue 继续跟踪
+            reply->deleteLater();
+            return;
+        }
+        if (delta && statusCode == 412) { // Precondition Failed：服务端没有对应的基准（重启/被其他设备覆盖），完整重发
+            qWarning() << "WARN: Delta base unknown to server, resend full payload.";
+            deltaSync.forget(hashId);
+            reply->setProperty("retryReply", QVariant::fromValue<QObject*>(postPayload(payload)));
+            reply->deleteLater();
+            return;
+        }
         if (reply->error() == QNetworkReply::NoError) { // 实验室环境, （第二次发）1KB以上数据（图片）比1KB以下（文本）要快（40ms vs 120ms）离谱！！
-            qDebug() << "↑Copied to Cloud √." << statusCode << Util::printDataSize(data.size()) << start.msecsTo(QTime::currentTime()) << "ms";
+            const int elapsedMs = start.msecsTo(QTime::currentTime());
+            qDebug() << "↑Copied to Cloud √." << statusCode << Util::printDataSize(postData.size()) << elapsedMs << "ms";
+            uplink.record(postData.size(), elapsedMs);
+            if (payload.fingerprint) capturePipeline->encodeCache().markUploaded(payload.fingerprint);
             tipWidget->hide();
+            deltaSync.acknowledge(hashId, payload, reply->rawHeader("X-Delta-Base")); // 旧服务端没有该头，不启用增量
+            outbox->discard(hashId); // 更新的数据已送达，离线期间的旧数据作废
         } else {
             qCritical() << "× !!Post Error:" << statusCode << reply->errorString();
             tipWidget->showFailedStyle();
             QTimer::singleShot(2000, tipWidget, &TipWidget::hide);
-            sysTray->showMessage("Post Error", QString("code: %1, msg: %2").arg(statusCode).arg(reply->errorString()), QSystemTrayIcon::Warning);
+            sysTray->showMessage("Post Error", QString("code: %1, msg: %2\nWill retry when reconnected.").arg(statusCode).arg(reply->errorString()), QSystemTrayIcon::Warning);
+            outbox->append(hashId, payload);
         }
         reply->deleteLater(); //比delete更安全，因为不确定是否有其他slot未执行
     });
 
     // SSL会话缓存重用貌似也会触发这个？
     connect(reply, &QNetworkReply::encrypted, this, [=]() {
-        qDebug() << "SSL握手完成时间:" << start.msecsTo(QTime::currentTime()) << "ms; sessionTicket size:"
+        const int handshakeMs = start.msecsTo(QTime::currentTime());
+        qDebug() << "SSL握手完成时间:" << handshakeMs << "ms; sessionTicket size:"
                  << reply->sslConfiguration().sessionTicket().size() << "protocol:"<< reply->sslConfiguration().protocol();
+        if (tlsTicket.isEmpty())
+            reply->setProperty("tlsFullHandshakeMs", handshakeMs); // 见 saveTlsSession
+        else if (fullHandshakeMs > 0)
+            qDebug() << "TLS handshake saved ≈" << qMax(0, fullHandshakeMs - handshakeMs) << "ms (full handshake:" << fullHandshakeMs << "ms)";
     });
     connect(reply, &QNetworkReply::sslErrors, this, [=](const QList<QSslError>& errors) {
         qDebug() << "SSL握手错误:" << errors;
     });
+    return reply;
 }
 
-void Widget::pollCloudClip()
+QNetworkReply* Widget::postFiles(const ClipPayload& payload)
 {
-    QNetworkRequest request(QUrl(QString("%1/clipboard/long-polling/%2/win").arg(baseUrl, hashId)));
-    // 可以加入心跳机制确保更快重连（丢弃失败的连接），毕竟90s还是太长
-    // 不过等我遇到问题再加吧hh 应该是小概率事件，相信HTTP！
-    request.setTransferTimeout(90 * 1000); // 90s超时时间，避免服务端掉线 & 网络异常造成的无响应永久等待
-    QNetworkReply *reply = manager->get(request);
-    this->pollingReply = reply; // for aborting it when server changed
-    qDebug() << "+Start long-polling...";
-
-    connect(reply, &QNetworkReply::finished, this, [=]() {
+    const qint64 total = FileTransfer::totalSize(payload.files);
+    if (cipher) { // 文件内容流式上传，不经过 PayloadCipher；不能让用户误以为它也是端到端加密的
+        qWarning() << "WARN: Files can't be end-to-end encrypted, ignore.";
+        sysTray->showMessage("WARN", "Copying files is unavailable while end-to-end encryption is on.", QSystemTrayIcon::Warning);
+        return nullptr;
+    }
+    const QByteArray header = WireFormat::encodeFileListHeader(payload);
+    if (total > qint64(maxFileMB) * 1024 * 1024 || header.isEmpty()) {
+        qWarning() << "WARN: Files too large, ignore." << Util::printDataSize(total);
+        sysTray->showMessage("WARN", QString("Files too large (%1), the limit is %2 MB.").arg(Util::printDataSize(total)).arg(maxFileMB));
+        return nullptr;
+    }
+    auto device = new FileUploadDevice(header, payload.files);
+    if (!device->open(QIODevice::ReadOnly)) {
+        qWarning() << "WARN:" << device->errorString();
+        sysTray->showMessage("WARN", device->errorString(), QSystemTrayIcon::Warning);
+        delete device;
+        return nullptr;
+    }
+
+    QNetworkRequest request(QUrl(QString("%1/clipboard/files/%2/%3").arg(baseUrl, hashId, payload.os)));
+    request.setTransferTimeout(8 * 1000); // 一直没有数据传输才超时，大文件不受影响
+    request.setHeader(QNetworkRequest::ContentTypeHeader, WireFormat::BINARY_MIME);
+    request.setHeader(QNetworkRequest::ContentLengthHeader, device->size());
+
+    QTime start = QTime::currentTime();
+    QNetworkReply *reply = manager->post(request, device); // 按块从映射的文件中读取，不整体读入内存
+    device->setParent(reply); // 随 reply 一起释放
+    tipWidget->showNormalStyle();
+
+    QObject::connect(reply, &QNetworkReply::finished, this, [=]() {
         int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-        qDebug() << "-Long polling done." << statusCode;
+        if (reply->property("superseded").toBool()) {
+            qDebug() << "↑File upload superseded by newer clipboard data.";
+            reply->deleteLater();
+            return;
+        }
         if (reply->error() == QNetworkReply::NoError) {
-            QByteArray replyData = reply->readAll();
-            QJsonDocument doc = QJsonDocument::fromJson(replyData);
-            QJsonObject jsonData = doc.object();
+            const int elapsedMs = start.msecsTo(QTime::currentTime());
+            qDebug() << "↑Files copied to Cloud √." << statusCode << payload.files.size() << "file(s)," << Util::printDataSize(device->size()) << elapsedMs << "ms";
+            uplink.record(device->size(), elapsedMs);
+            if (payload.fingerprint) capturePipeline->encodeCache().markUploaded(payload.fingerprint);
+            tipWidget->hide();
+        } else {
+            QString msg = QString("code: %1, msg: %2").arg(statusCode).arg(reply->errorString());
+            if (statusCode == 404 || statusCode == 405)
+                msg = "The server doesn't support copying files.";
+            else if (statusCode == 413)
+                msg = "Files too large for the server.";
+            qCritical() << "× !!Post Files Error:" << statusCode << reply->errorString();
+            tipWidget->showFailedStyle();
+            QTimer::singleShot(2000, tipWidget, &TipWidget::hide);
+            sysTray->showMessage("Post Error", msg, QSystemTrayIcon::Warning); // 文件可能随时变化，不进离线发件箱
+        }
+        reply->deleteLater();
+    });
+    return reply;
+}
 
-            const QString os = jsonData.value("os").toString();
-            const QString base64Data = jsonData.value("data").toString();
-            const QByteArray base64Bytes = base64Data.toUtf8();
-            const QByteArray data = QByteArray::fromBase64(base64Bytes); //base64解码
-            const bool isText = jsonData.value("isText").toBool();
+void Widget::downloadFiles(const ClipPayload& payload)
+{
+    const qint64 total = FileTransfer::totalSize(payload.files);
+    const QString source = payload.os == "ios" ? "iOS" : payload.os == "win" ? "Windows" : payload.os;
+    if (total > qint64(maxFileMB) * 1024 * 1024) {
+        qWarning() << "WARN: Incoming files too large, skip." << Util::printDataSize(total);
+        sysTray->showMessage("Files skipped", QString("%1 file(s) from %2 (%3) exceed the %4 MB limit.")
+                             .arg(payload.files.size()).arg(source, Util::printDataSize(total)).arg(maxFileMB));
+        return;
+    }
+    if (payload.id.isEmpty()) {
+        qWarning() << "WARN: File list without message id, unable to download.";
+        return;
+    }
 
-            if (os == "ios" && !data.isEmpty()) {
-                isMeSetClipboard = true;
-                QString readableSize = Util::printDataSize(base64Bytes.size());
-                if (isText) {
-                    auto text = QString::fromUtf8(data);
-                    qApp->clipboard()->setText(text);
-                    auto httpUrl = Util::extractFirstHttpUrl(text);
-                    if (!httpUrl.isEmpty()) {
-                        qDebug() << "Detected URL in Pasted Text";
-                        Util::downloadFaviconIcoToTemp(manager, httpUrl, [=](QString localIcoPath){
-                            auto tmCode = Util::parseTencentMeetingCode(httpUrl);
-                            if (!tmCode.isEmpty()) { // 腾讯会议链接
-                                bool isTMInstalled = Util::isTencentMeetingInstalled();
-                                showToastWithActions(localIcoPath, "Tencent Meeting invitation", text, "code: " + tmCode, [=](int actionIndex){
-                                    if (actionIndex == 0) // Open
-                                        QDesktopServices::openUrl(QUrl(httpUrl));
-                                    else if (actionIndex == 1)
-                                        Util::openTencentMeetingClient(tmCode);
-                                }, "Open in browser 🌐", isTMInstalled ? "Launch App 🖥️" : "");
-                            } else { // 普通超链接
-                                showToastWithActions(localIcoPath, "Link detected. Click to Open", text, "from iOS", [=](int actionIndex){
-                                    if (actionIndex == 0) // Open
-                                        QDesktopServices::openUrl(QUrl(httpUrl));
-                                });
-                            }
+    const QString channel = payload.channel.isEmpty() ? hashId : payload.channel;
+    QNetworkRequest request(QUrl(QString("%1/clipboard/files/%2/%3").arg(baseUrl, channel, payload.id)));
+    request.setTransferTimeout(8 * 1000);
+    // 边收边写入下载目录：读缓冲有上限，内存占用与文件大小无关；写盘在 I/O 线程中，磁盘慢时由 TCP 反压（见 FileDownloadJob）
+    const quint64 generation = clipGeneration;
+    QTime start = QTime::currentTime();
+    auto job = new FileDownloadJob(manager->get(request), downloadDir, payload.files, this);
+    connect(job, &FileDownloadJob::finished, this, [=](bool ok, const QStringList& paths, const QString& error) {
+        if (!ok) {
+            qCritical() << "× !!Download Files Error:" << error;
+            sysTray->showMessage("Download Error", error, QSystemTrayIcon::Warning);
+            return;
+        }
+        QStringList names;
+        for (const QString& path : paths)
+            names << QFileInfo(path).fileName();
+        qDebug() << "↓Files from" << source << payload.origin << "saved to" << downloadDir << ";" << Util::printDataSize(total)
+                 << start.msecsTo(QTime::currentTime()) << "ms";
+        if (generation != clipGeneration) { // 下载期间本地复制了新内容或收到了新消息：文件保留，但不覆盖剪贴板
+            qDebug() << "Info: Clipboard changed during download, keep files only.";
+            sysTray->showMessage("↓Saved Files from " + source, QString("%1\n%2 → %3").arg(names.join(", "), Util::printDataSize(total), downloadDir));
+            return;
+        }
+        capturePipeline->encodeCache().clearUploaded(); // 服务端的最新值已不是本机上传的内容
+        QList<QUrl> urls;
+        for (const QString& path : paths)
+            urls << QUrl::fromLocalFile(path);
+        auto mimeData = new QMimeData;
+        mimeData->setUrls(urls); // 可直接在资源管理器 / 聊天窗口中粘贴
+        isMeSetClipboard = true;
+        qApp->clipboard()->setMimeData(mimeData);
+        sysTray->showMessage("↓Pasted Files from " + source, QString("%1\n%2 → %3").arg(names.join(", "), Util::printDataSize(total), downloadDir));
+    });
+}
+
+void Widget::pasteTextFile(const QString& spillFile, const QString& source, const QString& readableSize)
+{
+    const QString name = QDateTime::currentDateTime().toString("'clipboard-'yyyyMMdd-hhmmss'.txt'");
+    const QString path = FileTransfer::uniquePath(downloadDir, name);
+    if (!QDir().mkpath(downloadDir) || !QFile::rename(spillFile, path)) { // 跨分区时 rename 会退回复制
+        isMeSetClipboard = false;
+        qCritical() << "× Unable to save large text to" << path;
+        sysTray->showMessage("WARN", "Unable to save large text to " + downloadDir, QSystemTrayIcon::Warning);
+        return;
+    }
+    auto mimeData = new QMimeData;
+    mimeData->setUrls({QUrl::fromLocalFile(path)});
+    qApp->clipboard()->setMimeData(mimeData);
+    qDebug() << "Large text saved to" << path;
+    sysTray->showMessage("↓Pasted Text from " + source, QString("Too large for the clipboard (%1), copied as a file:\n%2").arg(readableSize, path));
+}
+
+void Widget::handleCloudMessage(const ClipPayload& payload, int wireSize)
+{
+    if (!payload.id.isEmpty()) {
+        if (recentMessageIds.contains(payload.id)) {
+            qDebug() << "Duplicate message, ignore. id:" << payload.id;
+            if (!payload.dataFile.isEmpty()) QFile::remove(payload.dataFile);
+            return;
+        }
+        recentMessageIds << payload.id;
+        if (recentMessageIds.size() > 32) recentMessageIds.removeFirst();
+    }
+    if (!recentLanFingerprints.isEmpty() && payload.dataFile.isEmpty() // 落盘的大消息不会走局域网
+        && recentLanFingerprints.removeOne(Util::fingerprint(payload.data.constData(), size_t(payload.data.size())))) {
+        qDebug() << "Already received over LAN, ignore cloud copy."; // 每次直连只抵消一次云端副本
+        return;
+    }
+    applyIncoming(payload, wireSize);
+}
+
+void Widget::handleLanMessage(const ClipPayload& payload, int wireSize)
+{
+    recentLanFingerprints << Util::fingerprint(payload.data.constData(), size_t(payload.data.size()));
+    if (recentLanFingerprints.size() > 8) recentLanFingerprints.removeFirst();
+    qDebug() << "↓Received over LAN from" << payload.origin;
+    applyIncoming(payload, wireSize);
+}
+
+void Widget::applyIncoming(const ClipPayload& payload, int wireSize)
+{
+    const QByteArray& data = payload.data;
+    const bool isText = payload.isText;
+    const bool spilled = !payload.dataFile.isEmpty(); // 超过内存上限，载荷在临时文件中
+    auto removeSpill = qScopeGuard([&]{ if (spilled) QFile::remove(payload.dataFile); }); // 已移走的文件不受影响
+    // 多路复用服务端会扇出给频道内的所有其他设备，靠 origin 排除自己；旧服务端的 /win 路由只会下发 iOS 的数据
+    const bool fromOtherDevice = payload.origin.isEmpty() ? payload.os == "ios" : payload.origin != deviceId;
+    const QString source = payload.os == "ios" ? "iOS" : payload.os == "win" ? "Windows" : payload.os;
+
+    if (fromOtherDevice) { // 还在解码的旧图像、还在下载的旧文件不再覆盖剪贴板
+        receivePipeline->cancel();
+        ++clipGeneration;
+    }
+    if (fromOtherDevice && !payload.files.isEmpty()) { // 只有元数据，内容另行下载
+        downloadFiles(payload);
+        return;
+    }
+    if (fromOtherDevice && (!data.isEmpty() || spilled)) {
+        capturePipeline->encodeCache().clearUploaded(); // 服务端的最新值已不是本机上传的内容
+        QString readableSize = Util::printDataSize(wireSize);
+        if (isText && spilled) { // 超大文本不放进剪贴板（接收方同样要整块读入），改为保存成文件，复制文件
+            isMeSetClipboard = true;
+            pasteTextFile(payload.dataFile, source, readableSize);
+        } else if (isText) {
+            auto text = QString::fromUtf8(data);
+            isMeSetClipboard = true;
+            qApp->clipboard()->setText(text);
+            auto httpUrl = Util::extractFirstHttpUrl(text);
+            if (!httpUrl.isEmpty()) {
+                qDebug() << "Detected URL in Pasted Text";
+                Util::downloadFaviconIcoToTemp(manager, httpUrl, [=](QString localIcoPath){
+                    auto tmCode = Util::parseTencentMeetingCode(httpUrl);
+                    if (!tmCode.isEmpty()) { // 腾讯会议链接
+                        bool isTMInstalled = Util::isTencentMeetingInstalled();
+                        showToastWithActions(localIcoPath, "Tencent Meeting invitation", text, "code: " + tmCode, [=](int actionIndex){
+                            if (actionIndex == 0) // Open
+                                QDesktopServices::openUrl(QUrl(httpUrl));
+                            else if (actionIndex == 1)
+                                Util::openTencentMeetingClient(tmCode);
+                        }, "Open in browser 🌐", isTMInstalled ? "Launch App 🖥️" : "");
+                    } else { // 普通超链接
+                        showToastWithActions(localIcoPath, "Link detected. Click to Open", text, "from " + source, [=](int actionIndex){
+                            if (actionIndex == 0) // Open
+                                QDesktopServices::openUrl(QUrl(httpUrl));
                         });
-                    } else
-                        sysTray->showMessage("↓Pasted Text from IOS", text); //可以在 系统-通知 中关闭声音
-                } else {
-                    auto img = QImage::fromData(data);
-                    qApp->clipboard()->setImage(img);
-                    // https://learn.microsoft.com/en-us/windows/apps/develop/notifications/app-notifications/adaptive-interactive-toasts?tabs=appsdk#hero-image
-                    auto thumbnail = img.scaled(364, 180, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
-                    auto thumbPath = Util::saveImageToTemp(thumbnail, "jpg");
-                    qDebug() << "Image saved to temp path:" << thumbPath;
-                    auto bodyText = QString("%1  (%2 × %3)").arg(readableSize).arg(img.width()).arg(img.height());
-                    showToastWithHeroImageText(thumbPath, "Click to save image", bodyText, [img]{ // 弹窗选择保存位置
-                        auto path = QFileDialog::getSaveFileName(nullptr, "Save Image", {}, "Images (*.jpg *.png)");
-                        if (path.isEmpty()) return;
-                        if (img.save(path)) {
-                            Util::openExplorerAndSelectFile(path);
-                            qDebug() << "Image saved to:" << path;
-                        }
-                    });
-                }
-                qDebug() << "↓Pasted from IOS;" << readableSize;
-                // TODO 为什么一张照片在这里显示 993 KB，但是copy到QQ聊天框保存到本地后有6.88MB (because .jpg to .png!?)
-            }
+                    }
+                });
+            } else
+                sysTray->showMessage("↓Pasted Text from " + source, text); //可以在 系统-通知 中关闭声音
         } else {
-            qCritical() << "× !!Get Error:" << reply->errorString();
+            removeSpill.dismiss(); // 落盘的大图交给流水线，解码后作为原图文件交回
+            // 解码、预览图缩放与保存都在工作线程中，GUI线程只设置剪贴板
+            receivePipeline->submit(payload, [=](const ReceivedImage& result) {
+                if (result.isEmpty()) {
+                    if (!result.encodedFile.isEmpty()) QFile::remove(result.encodedFile);
+                    sysTray->showMessage("WARN", "Unable to decode the image from " + source, QSystemTrayIcon::Warning);
+                    return;
+                }
+                const QImage& img = result.image;
+                // 位图之外同时按原格式提供编码字节：支持的程序（浏览器、图片编辑器）直接粘贴原图，不经过位图再编码（993 KB 的 jpg 变成 6.88 MB 的 png）
+                // 延迟渲染：只声明格式，使用方请求时才准备数据，落盘的大图粘贴时才读取；原图文件随剪贴板内容一起删除
+                isMeSetClipboard = true;
+                qApp->clipboard()->setMimeData(new DeferredMimeData(result));
+                qDebug() << "Image saved to temp path:" << result.thumbPath;
+                auto bodyText = img.isNull() ? QString("%1  %2").arg(readableSize, result.mimeType)
+                                             : QString("%1  %2 (%3 × %4)").arg(readableSize, result.suffix.toUpper()).arg(img.width()).arg(img.height());
+                showToastWithHeroImageText(result.thumbPath, "Click to save image", bodyText, [=]{ // 弹窗选择保存位置
+                    saveReceivedImage(result);
+                });
+            });
         }
-        reply->deleteLater();
-        this->pollingReply = nullptr;
+        qDebug() << "↓Pasted from" << source << payload.origin << "channel:" << payload.channel << ";" << readableSize;
+    }
+}
 
-        QTimer::singleShot(1000, this, &Widget::pollCloudClip);
-    });
+void Widget::saveReceivedImage(const ReceivedImage& result)
+{
+    // 原样写出收到的字节，不解码再编码：更快、更小、无损；无法识别格式时才退回位图编码
+    const bool original = !result.suffix.isEmpty();
+    const QString filter = original ? QString("Original image (*.%1)").arg(result.suffix) : "Images (*.jpg *.png)";
+    auto path = QFileDialog::getSaveFileName(nullptr, "Save Image", {}, filter);
+    if (path.isEmpty()) return;
+    bool ok;
+    if (!original) {
+        ok = result.image.save(path);
+    } else if (!result.encodedFile.isEmpty()) { // 剪贴板内容被替换后，该文件已随之删除
+        if (!QFile::exists(result.encodedFile)) {
+            sysTray->showMessage("WARN", "The original image is no longer on the clipboard.", QSystemTrayIcon::Warning);
+            return;
+        }
+        QFile::remove(path); // 对话框已确认覆盖，QFile::copy 不会覆盖已有文件
+        ok = QFile::copy(result.encodedFile, path);
+    } else {
+        QFile file(path);
+        ok = file.open(QIODevice::WriteOnly) && file.write(result.encoded) == result.encoded.size();
+    }
+    if (!ok) {
+        qCritical() << "× Unable to save image to" << path;
+        sysTray->showMessage("WARN", "Unable to save image to " + path, QSystemTrayIcon::Warning);
+        return;
+    }
+    Util::openExplorerAndSelectFile(path);
+    qDebug() << "Image saved to:" << path << (original ? "(original bytes)" : "");
 }
 
 void Widget::updateConnectionStatus(bool isConnected)
@@ -300,7 +638,7 @@ void Widget::initSystemTray()
     QAction* act_autoStart = new QAction("Auto-Start", menu);
     QAction* act_quit = new QAction("Quit>>", menu);
 
-    connect(act_post, &QAction::triggered, this, &Widget::postClipboard);
+    connect(act_post, &QAction::triggered, this, [=]() { postClipboard(); });
     connect(act_setting, &QAction::triggered, this, &Widget::showNormal);
 
     act_recvOnly->setCheckable(true);
@@ -345,6 +683,20 @@ void Widget::readSettings()
     QString userId = ini.value("user/id").toString();
     QString uuid = ini.value("user/uuid").toString();
     bool recvOnly = ini.value("app/recvOnly", false).toBool();
+    this->heartbeatMs = ini.value("net/heartbeatMs", heartbeatMs).toInt();
+    this->livenessMs = ini.value("net/livenessMs", livenessMs).toInt();
+    this->standbyPoll = ini.value("net/standbyPoll", standbyPoll).toBool();
+    this->lanEnabled = ini.value("lan/enabled", lanEnabled).toBool();
+    this->e2eEnabled = ini.value("e2e/enabled", e2eEnabled).toBool();
+    this->extraChannels = ini.value("channels/extra").toStringList();
+    this->maxFileMB = ini.value("files/maxMB", maxFileMB).toInt();
+    this->downloadDir = ini.value("files/downloadDir", downloadDir).toString();
+    this->recvMemoryCapMB = ini.value("recv/memoryCapMB", recvMemoryCapMB).toInt();
+    this->deviceId = ini.value("device/id").toString();
+    if (deviceId.isEmpty()) { // 旧版本升级：立即生成并保存，保证ID稳定
+        deviceId = Util::genUUID();
+        ini.setValue("device/id", deviceId);
+    }
 
     if (baseUrl.isEmpty() || uuid.isEmpty()) { // UserID可以为空
         qWarning() << "WARN: Settings file Error.";
@@ -375,6 +727,16 @@ void Widget::writeSettings()
     ini.setValue("user/uuid", uuid);
 
     ini.setValue("app/recvOnly", recvOnly);
+    ini.setValue("net/heartbeatMs", heartbeatMs);
+    ini.setValue("net/livenessMs", livenessMs);
+    ini.setValue("net/standbyPoll", standbyPoll);
+    ini.setValue("lan/enabled", lanEnabled);
+    ini.setValue("e2e/enabled", e2eEnabled);
+    ini.setValue("channels/extra", extraChannels);
+    ini.setValue("files/maxMB", maxFileMB);
+    ini.setValue("files/downloadDir", downloadDir);
+    ini.setValue("recv/memoryCapMB", recvMemoryCapMB);
+    ini.setValue("device/id", deviceId);
 
     qDebug() << "Write settings:" << baseUrl << userId << uuid;
 }
@@ -382,6 +744,7 @@ void Widget::writeSettings()
 void Widget::initSettings()
 {
     this->uuid = Util::genUUID();
+    this->deviceId = Util::genUUID();
     this->baseUrl = defaultServerUrl;
 
     this->show();
@@ -412,6 +775,65 @@ void Widget::showQrCode(const QString& text)
     ui->label_qr->setToolTip("UUID");
 }
 
+void Widget::restoreTlsSession()
+{
+    QSettings ini(SETTINGS_FILE, QSettings::IniFormat);
+    this->fullHandshakeMs = ini.value("tls/fullHandshakeMs", 0).toInt();
+    ini.remove("tls/sessionTicket"); // 旧版本以明文保存，删掉
+
+    const QString host = QUrl(baseUrl).host();
+    if (ini.value("tls/host").toString() != host) return; // ticket 只对签发它的服务器有效
+
+    // RFC 8446: ticket 有效期不超过7天，以服务端给出的 lifetime hint 为准；hint 为 0 表示未指定（RFC 5077），按默认值
+    const qint64 savedAt = ini.value("tls/savedAt", 0).toLongLong();
+    const int hint = ini.value("tls/lifetimeHint", 0).toInt();
+    const int lifetime = qMin(hint > 0 ? hint : DEFAULT_TICKET_LIFETIME, 7 * 24 * 3600);
+    if (QDateTime::currentSecsSinceEpoch() - savedAt >= lifetime) {
+        qDebug() << "TLS session ticket expired.";
+        return;
+    }
+
+    // ticket 可用于恢复会话（TLS 1.2 下还能解密用它恢复的流量），只以 DPAPI 加密后的形式落盘
+    this->tlsTicket = Util::unprotectData(QByteArray::fromBase64(ini.value("tls/protectedTicket").toByteArray()));
+    qDebug() << "TLS session ticket restored:" << tlsTicket.size() << "bytes";
+}
+
+void Widget::saveTlsSession(QNetworkReply* reply)
+{
+    const QUrl url = reply->url();
+    if (url.scheme() != "https" || url.host() != QUrl(baseUrl).host()) return;
+
+    const QSslConfiguration conf = reply->sslConfiguration();
+    const QByteArray ticket = conf.sessionTicket();
+    if (ticket.isEmpty() || ticket == tlsTicket) return;
+
+    QSettings ini(SETTINGS_FILE, QSettings::IniFormat);
+    if (tlsTicket.isEmpty() && fullHandshakeMs == 0 && reply->property("tlsFullHandshakeMs").isValid()) {
+        // 没有可恢复的 ticket 时的握手一定是完整握手，记下来作为基准
+        this->fullHandshakeMs = reply->property("tlsFullHandshakeMs").toInt();
+        ini.setValue("tls/fullHandshakeMs", fullHandshakeMs);
+    }
+    this->tlsTicket = ticket;
+    const QByteArray sealed = Util::protectData(ticket);
+    if (sealed.isEmpty()) return; // 加密失败则只留在内存中
+    ini.setValue("tls/host", url.host());
+    ini.setValue("tls/protectedTicket", sealed.toBase64());
+    ini.setValue("tls/lifetimeHint", conf.sessionTicketLifeTimeHint());
+    ini.setValue("tls/savedAt", QDateTime::currentSecsSinceEpoch());
+}
+
+void Widget::prewarmConnection()
+{
+    const QUrl url(baseUrl);
+    if (url.scheme() != "https") return;
+
+    QSslConfiguration conf = QSslConfiguration::defaultConfiguration();
+    if (!tlsTicket.isEmpty())
+        conf.setSessionTicket(tlsTicket); // 只给本服务器用，避免把 ticket 带给其他站点（如favicon下载）
+    manager->connectToHostEncrypted(url.host(), quint16(url.port(443)), conf);
+    qDebug() << "Pre-connect to" << url.host() << (tlsTicket.isEmpty() ? "(full handshake)" : "(resume session)");
+}
+
 QString Widget::genHashID()
 {
     //TODO 改为 (uuid + userId + day)的hash值，每日动态变化，保证安全性
@@ -420,6 +842,31 @@ QString Widget::genHashID()
     return _hashId;
 }
 
+void Widget::updateCipher()
+{
+    cipher.reset();
+    if (e2eEnabled) {
+        QSharedPointer<PayloadCipher> c(new PayloadCipher(PayloadCipher::deriveKey(uuid, userId)));
+        if (c->isValid()) {
+            cipher = c;
+            // 对比网络耗时（2MB 上传通常数百毫秒），加密开销应可忽略
+            qDebug() << "E2E encryption on; AES-GCM throughput:" << qRound(cipher->benchmark()) << "MB/s";
+        } else {
+            sysTray->showMessage("WARN", "End-to-end encryption unavailable, data will be sent unencrypted.", QSystemTrayIcon::Warning);
+        }
+    }
+    pushChannel->setCipher(cipher);
+}
+
+QStringList Widget::subscribedChannels() const
+{
+    QStringList channels {hashId}; // 主频道在前，旧服务端只订阅它
+    for (const QString& channel : extraChannels)
+        if (!channel.isEmpty() && !channels.contains(channel))
+            channels << channel;
+    return channels;
+}
+
 void Widget::showEvent(QShowEvent* event)
 {
     showSettingData();
@@ -5,7 +5,21 @@
 #include <QSystemTrayIcon>
 #include <QWidget>
 #include <QApplication>
+#include <QSharedPointer>
+#include <QStandardPaths>
 #include "TipWidget.h"
+#include "clipcoalescer.h"
+#include "deltasync.h"
+#include "capturepipeline.h"
+#include "receivepipeline.h"
+#include "uplinkmeter.h"
+
+class PushChannel;
+class LanPeer;
+class PayloadCipher;
+class UploadQueue;
+class OutboxJournal;
+struct ClipPayload;
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -21,8 +35,18 @@ public:
     Widget(QWidget *parent = nullptr);
     ~Widget();
 private:
-    void postClipboard();
-    void pollCloudClip();
+    void postClipboard(bool coalesce = false);
+    void onCaptured(const ClipPayload& payload, quint64 fingerprint, const QString& reduction, bool coalesce); // 编码完成，发送
+    void sendPayload(const ClipPayload& payload);
+    CapturePipeline::WireOptions wireOptions(void) const;
+    QNetworkReply* postPayload(const ClipPayload& payload);
+    QNetworkReply* postFiles(const ClipPayload& payload);
+    void downloadFiles(const ClipPayload& payload);
+    void pasteTextFile(const QString& spillFile, const QString& source, const QString& readableSize);
+    void saveReceivedImage(const ReceivedImage& result);
+    void handleCloudMessage(const ClipPayload& payload, int wireSize);
+    void handleLanMessage(const ClipPayload& payload, int wireSize);
+    void applyIncoming(const ClipPayload& payload, int wireSize);
     void updateConnectionStatus(bool isConnected);
     void initSystemTray();
     void readSettings();
@@ -31,7 +55,12 @@ private:
     void reflashUUID();
     void showSettingData();
     void showQrCode(const QString& text);
+    void restoreTlsSession();
+    void saveTlsSession(QNetworkReply* reply);
+    void prewarmConnection();
     QString genHashID(void);
+    QStringList subscribedChannels(void) const;
+    void updateCipher(void);
 
 signals:
     void appReady();
@@ -46,16 +75,46 @@ private:
     QSystemTrayIcon *sysTray = nullptr;
     bool isConnected = false; //与服务器的连接状态
     bool isMeSetClipboard = false; //是否是本程序设置了剪贴板
+    quint64 sendSeq = 0; //每次发送递增，局域网回调晚于更新的发送时作废，避免旧数据晚到覆盖服务端的新数据
+    quint64 clipGeneration = 0; //本地复制 / 手动发送 / 收到新消息时递增，晚完成的下载据此判断剪贴板是否已被取代
+    ClipCoalescer clipCoalescer; //合并短时间内重复的剪贴板事件
     TipWidget *tipWidget = nullptr;
-    QNetworkReply* pollingReply = nullptr;
+    PushChannel* pushChannel = nullptr;
+    UploadQueue* uploadQueue = nullptr; //latest-wins 上传调度
+    CapturePipeline* capturePipeline = nullptr; //图像转换、编码等耗时操作移出GUI线程
+    ReceivePipeline* receivePipeline = nullptr; //收到的图像在工作线程中解码、生成预览图
+    OutboxJournal* outbox = nullptr; //离线发件箱，上传失败的数据在恢复连接后重发
+    UplinkMeter uplink; //上行带宽估计，决定图像的字节预算
+    const int TARGET_UPLOAD_MS = 3000; //图像预计上传耗时的目标（上传超时为8s）
+    const int MIN_IMAGE_BUDGET = 256 * 1024; //带宽再低也不把图像压到比这更小
+    bool binaryWire = false; //服务端是否支持二进制格式（通过 Accept-Post 响应头协商）
+    QByteArray tlsTicket; //持久化的 TLS session ticket，重启后恢复，免去完整握手
+    int fullHandshakeMs = 0; //无 ticket 时完整握手的耗时，用于估算节省的时间
+    const int DEFAULT_TICKET_LIFETIME = 2 * 3600; //服务端未给出 lifetime hint 时的有效期（OpenSSL 的默认值）
+    bool deflateWire = false; //服务端是否接受 deflate 压缩的载荷（通过 Accept-Encoding 响应头协商，RFC 7694）
+    DeltaSync deltaSync; //大文本增量上传（服务端通过 X-Delta-Base 响应头确认基准）
+    int maxFileMB = 32; //复制文件的总大小上限（上传 & 下载）
+    QString downloadDir = QStandardPaths::writableLocation(QStandardPaths::DownloadLocation) + "/Dog-Paw"; //收到的文件直接写入该目录
+    int recvMemoryCapMB = 8; //收到的消息超过该大小时转存到临时文件，常驻内存不随消息大小增长
 
     const QString defaultServerUrl = "https://clipboard.aliaba.fun";
     QString baseUrl;
     QString userId;
     QString uuid;
     QString hashId;
+    QString deviceId; //本机设备ID，同一频道内多台设备时区分消息来源，首次运行生成
+    QStringList extraChannels; //额外订阅的频道（其他hashId），与主频道共用一个推送连接
+    QStringList recentMessageIds; //最近收到的消息ID，重叠长轮询 / 重连时去重
+    LanPeer* lanPeer = nullptr; //局域网直连，同一网络内的设备不绕道云端
+    bool lanEnabled = false; //默认关闭，需在 .ini 中开启
+    bool e2eEnabled = false; //端到端加密（iOS快捷指令无法解密，默认关闭）
+    QSharedPointer<PayloadCipher> cipher; //e2eEnabled 时由 uuid & userId 派生密钥
+    QList<quint64> recentLanFingerprints; //最近通过局域网收到的数据，旧服务端仍会经云端再下发一次，据此去重
 
     bool isAppReady = false; //是否已经初始化完成
+    int heartbeatMs = 5000; //推送通道心跳间隔
+    int livenessMs = 12000; //超过该时间没有心跳，判定连接已死（如Wi-Fi漫游后的半开连接）
+    bool standbyPoll = false; //长轮询时保持一个额外的待命请求
     bool recvOnly = false; //仅接收模式，关闭监听剪贴板，不自动发送数据（for 隐私保护）
 
     // QWidget interface
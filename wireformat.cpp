@@ -0,0 +1,303 @@
+#include "wireformat.h"
+#include "util.h"
+#include "payloadcipher.h"
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <cctype>
+#include <QList>
+#include <QElapsedTimer>
+#include <QDebug>
+
+static const char MAGIC[4] = {'D', 'P', 'A', 'W'};
+
+// 标准 base64（带填充）写入 out；每组先读3字节再写4字节，out 可以与 in 重叠，只要写指针不超过未读的输入（见 encodeJson）
+static void toBase64(const uchar* in, int size, char* out)
+{
+    static const char TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int i = 0; i < size; i += 3) {
+        const uint b0 = in[i];
+        const uint b1 = i + 1 < size ? in[i + 1] : 0;
+        const uint b2 = i + 2 < size ? in[i + 2] : 0;
+        const uint v = b0 << 16 | b1 << 8 | b2;
+        *out++ = TABLE[v >> 18 & 63];
+        *out++ = TABLE[v >> 12 & 63];
+        *out++ = i + 1 < size ? TABLE[v >> 6 & 63] : '=';
+        *out++ = i + 2 < size ? TABLE[v & 63] : '=';
+    }
+}
+
+QByteArray WireFormat::encodeJson(const ClipPayload& payload, const PayloadCipher* cipher)
+{
+    // 1.图像进行 Base64 编码，防止老式设备进行隐式编解码导致信息丢失
+    // 2.文本也进行 BASE64 编码，防止外链明文泄露，造成言论安全问题（但服务端仍可见，真正的保密靠端到端加密）
+    // 元数据很小，仍用 QJsonDocument 生成；data 直接编码进输出缓冲，不经过 base64 副本、QString（UTF-16）、QJsonDocument
+    QJsonObject meta;
+    if (cipher) meta.insert("encrypted", true);
+    meta.insert("isText", payload.isText);
+    if (!payload.os.isEmpty())
+        meta.insert("os", payload.os);
+    if (!payload.origin.isEmpty())
+        meta.insert("origin", payload.origin);
+    const QByteArray suffix = "\"," + QJsonDocument(meta).toJson(QJsonDocument::Compact).mid(1); // 去掉 '{'
+    static const char PREFIX[] = "{\"data\":\"";
+    const int prefixSize = int(sizeof(PREFIX)) - 1;
+
+    const int dataSize = cipher ? PayloadCipher::sealedSize(payload.data.size()) : payload.data.size();
+    const int base64Size = (dataSize + 2) / 3 * 4;
+    QByteArray out(prefixSize + base64Size + suffix.size(), Qt::Uninitialized);
+    memcpy(out.data(), PREFIX, prefixSize);
+    const uchar* data = reinterpret_cast<const uchar*>(payload.data.constData());
+    if (cipher) {
+        // 密文直接写在缓冲末尾，再就地向前展开为 base64：写到第 k 组时写指针在 4k+4，未读的密文从 (base64Size - dataSize) + 3k+3 开始，
+        // base64Size - dataSize ≥ 组数，写指针不会追上未读的密文；后缀最后写入
+        char* sealed = out.data() + out.size() - dataSize;
+        if (!cipher->seal(payload.data.constData(), payload.data.size(), sealed)) return QByteArray();
+        data = reinterpret_cast<const uchar*>(sealed);
+    }
+    toBase64(data, dataSize, out.data() + prefixSize);
+    memcpy(out.data() + prefixSize + base64Size, suffix.constData(), size_t(suffix.size()));
+    return out;
+}
+
+QByteArray WireFormat::encodeBinary(const ClipPayload& payload, bool compress, const PayloadCipher* cipher)
+{
+    quint8 flags = 0;
+    if (payload.isText) flags |= FlagText;
+    if (!payload.deltaBase.isEmpty()) flags |= FlagDelta;
+
+    QByteArray compressed;
+    const int level = compress ? deflateLevel(payload) : 0;
+    if (level > 0) {
+        QElapsedTimer timer;
+        timer.start();
+        compressed = qCompress(payload.data, level);
+        const double ratio = double(compressed.size()) / payload.data.size();
+        qDebug() << "Deflate level" << level << ":" << Util::printDataSize(payload.data.size()) << "->"
+                 << Util::printDataSize(compressed.size()) << QString::number(ratio, 'f', 2) << timer.elapsed() << "ms";
+        if (ratio < 0.9) // 压缩率太低就发原始数据，省去对端解压
+            flags |= FlagDeflate;
+        else
+            compressed.clear();
+    }
+    const QByteArray& body = (flags & FlagDeflate) ? compressed : payload.data;
+    if (cipher) flags |= FlagEncrypted;
+    const int bodySize = cipher ? PayloadCipher::sealedSize(body.size()) : body.size();
+
+    QJsonObject meta;
+    if (!payload.os.isEmpty())
+        meta.insert("os", payload.os);
+    if (!payload.origin.isEmpty())
+        meta.insert("origin", payload.origin);
+    if (!payload.channel.isEmpty())
+        meta.insert("channel", payload.channel);
+    if (!payload.id.isEmpty())
+        meta.insert("id", payload.id);
+    if (!payload.deltaBase.isEmpty())
+        meta.insert("base", payload.deltaBase);
+    const QByteArray metaBytes = meta.isEmpty() ? QByteArray() : QJsonDocument(meta).toJson(QJsonDocument::Compact);
+
+    uchar header[HEADER_SIZE];
+    memcpy(header, MAGIC, 4);
+    header[4] = VERSION;
+    header[5] = flags;
+    qToBigEndian<quint16>(quint16(metaBytes.size()), header + 6);
+    qToBigEndian<quint32>(quint32(bodySize), header + 8);
+
+    // 一次性分配，payload 只拷贝一次（加密时直接把密文写入帧，加密即是这一次拷贝）
+    QByteArray frame(HEADER_SIZE + metaBytes.size() + bodySize, Qt::Uninitialized);
+    char* dst = frame.data();
+    memcpy(dst, header, HEADER_SIZE);
+    memcpy(dst + HEADER_SIZE, metaBytes.constData(), size_t(metaBytes.size()));
+    dst += HEADER_SIZE + metaBytes.size();
+    if (cipher) {
+        QElapsedTimer timer;
+        timer.start();
+        if (!cipher->seal(body.constData(), body.size(), dst)) {
+            qCritical() << "× Encrypt payload failed.";
+            return QByteArray();
+        }
+        qDebug() << "AES-GCM sealed" << Util::printDataSize(body.size()) << "in" << timer.nsecsElapsed() / 1000 << "us";
+    } else {
+        memcpy(dst, body.constData(), size_t(body.size()));
+    }
+    return frame;
+}
+
+QByteArray WireFormat::encodeFileListHeader(const ClipPayload& payload)
+{
+    QJsonArray files;
+    qint64 total = 0;
+    for (const ClipFile& file : payload.files) {
+        files.append(QJsonObject {{"name", file.name}, {"size", file.size}});
+        total += file.size;
+    }
+    QJsonObject meta {{"files", files}};
+    if (!payload.os.isEmpty())
+        meta.insert("os", payload.os);
+    if (!payload.origin.isEmpty())
+        meta.insert("origin", payload.origin);
+    const QByteArray metaBytes = QJsonDocument(meta).toJson(QJsonDocument::Compact);
+    if (metaBytes.size() > 0xFFFF || total > 0xFFFFFFFFLL) return QByteArray(); // 超出帧头字段范围
+
+    uchar header[HEADER_SIZE];
+    memcpy(header, MAGIC, 4);
+    header[4] = VERSION;
+    header[5] = FlagFiles;
+    qToBigEndian<quint16>(quint16(metaBytes.size()), header + 6);
+    qToBigEndian<quint32>(quint32(total), header + 8);
+    return QByteArray(reinterpret_cast<const char*>(header), HEADER_SIZE) + metaBytes;
+}
+
+bool WireFormat::decode(const QByteArray& body, const QString& contentType, ClipPayload* out, const PayloadCipher* cipher)
+{
+    Q_ASSERT(out);
+    // 长轮询的心跳是响应体前的空白字符（JSON 本身允许前导空白），二进制帧需要跳过
+    int offset = 0;
+    while (offset < body.size() && isspace(uchar(body[offset])))
+        offset++;
+    if (offset == body.size()) { // 只有心跳（长轮询超时）：空消息
+        *out = ClipPayload();
+        return true;
+    }
+    if (contentType.startsWith(BINARY_MIME) || isBinary(body, offset))
+        return decodeBinary(body, offset, out, cipher);
+    return decodeJson(body, out, cipher);
+}
+
+bool WireFormat::isBinary(const QByteArray& body, int offset)
+{
+    return body.size() - offset >= HEADER_SIZE && memcmp(body.constData() + offset, MAGIC, 4) == 0;
+}
+
+bool WireFormat::decodeJson(const QByteArray& body, ClipPayload* out, const PayloadCipher* cipher)
+{
+    QJsonParseError err;
+    QJsonDocument doc = QJsonDocument::fromJson(body, &err);
+    if (err.error != QJsonParseError::NoError || !doc.isObject())
+        return false;
+    QJsonObject jsonData = doc.object();
+    out->data = QByteArray::fromBase64(jsonData.value("data").toString().toLatin1()); //base64解码
+    return finishJson(jsonData, out, cipher);
+}
+
+bool WireFormat::finishJson(const QJsonObject& jsonData, ClipPayload* out, const PayloadCipher* cipher)
+{
+    out->os = jsonData.value("os").toString();
+    out->origin = jsonData.value("origin").toString();
+    out->channel = jsonData.value("channel").toString();
+    out->id = jsonData.value("id").toString();
+    out->isText = jsonData.value("isText").toBool();
+    out->files = decodeFiles(jsonData.value("files"));
+    if (jsonData.value("encrypted").toBool()) {
+        const QByteArray sealed = out->data;
+        if (!decrypt(sealed.constData(), sealed.size(), cipher, &out->data)) return false;
+    }
+    if (jsonData.value("deflate").toBool()) // 服务端把加密的二进制帧转成JSON时，无法替我们解压
+        out->data = qUncompress(out->data);
+    return true;
+}
+
+bool WireFormat::decodeBinary(const QByteArray& body, int offset, ClipPayload* out, const PayloadCipher* cipher)
+{
+    if (!isBinary(body, offset)) {
+        qWarning() << "WARN: Bad binary frame magic.";
+        return false;
+    }
+    const uchar* p = reinterpret_cast<const uchar*>(body.constData() + offset);
+    if (p[4] != VERSION) {
+        qWarning() << "WARN: Unsupported binary frame version:" << p[4];
+        return false;
+    }
+    const quint8 flags = p[5];
+    if (flags & FlagDelta) { // 增量只在上传方向出现，下发的一定是完整数据
+        qWarning() << "WARN: Unexpected delta frame.";
+        return false;
+    }
+    const int metaLen = qFromBigEndian<quint16>(p + 6);
+    const qint64 payloadLen = qFromBigEndian<quint32>(p + 8);
+    if (offset + HEADER_SIZE + metaLen + payloadLen > body.size()) {
+        qWarning() << "WARN: Truncated binary frame.";
+        return false;
+    }
+
+    const QJsonObject meta = metaLen > 0 ? QJsonDocument::fromJson(body.mid(offset + HEADER_SIZE, metaLen)).object() : QJsonObject();
+    const char* payload = body.constData() + offset + HEADER_SIZE + metaLen;
+    // 解密直接从帧中读取，不先拷贝出密文
+    const QByteArray raw = (flags & FlagEncrypted) ? QByteArray::fromRawData(payload, int(payloadLen)) : QByteArray(payload, int(payloadLen));
+    return finishBinary(flags, meta, raw, out, cipher);
+}
+
+bool WireFormat::finishBinary(quint8 flags, const QJsonObject& meta, const QByteArray& payload, ClipPayload* out, const PayloadCipher* cipher)
+{
+    out->os = meta.value("os").toString();
+    out->origin = meta.value("origin").toString();
+    out->channel = meta.value("channel").toString();
+    out->id = meta.value("id").toString();
+    out->isText = flags & FlagText;
+    if (flags & FlagFiles) { // 只有元数据，内容另行下载
+        out->files = decodeFiles(meta.value("files"));
+        out->data.clear();
+        return !out->files.isEmpty();
+    }
+    if (flags & FlagEncrypted) {
+        if (!decrypt(payload.constData(), payload.size(), cipher, &out->data)) return false;
+    } else {
+        out->data = payload;
+    }
+    if (flags & FlagDeflate) {
+        out->data = qUncompress(out->data);
+        if (out->data.isEmpty()) {
+            qWarning() << "WARN: Corrupted deflate payload.";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WireFormat::decrypt(const char* sealed, int size, const PayloadCipher* cipher, QByteArray* out)
+{
+    if (!cipher) {
+        qWarning() << "WARN: Encrypted payload, but end-to-end encryption is disabled.";
+        return false;
+    }
+    if (!cipher->open(sealed, size, out)) {
+        qWarning() << "WARN: Unable to decrypt payload (different UUID/UserID, or tampered).";
+        return false;
+    }
+    return true;
+}
+
+int WireFormat::deflateLevel(const ClipPayload& payload)
+{
+    const QByteArray& data = payload.data;
+    if (data.size() < COMPRESS_THRESHOLD) return 0;
+
+    if (payload.isText) // 文本（日志、代码、JSON）压缩率很高；超大文本用低级别换速度
+        return data.size() > 1024 * 1024 ? 1 : 6;
+
+    // 图像：JPEG/PNG/GIF/WebP 本身已压缩，再压只会浪费CPU
+    static const QList<QByteArray> compressedMagics = {
+        QByteArray("\xFF\xD8\xFF", 3),       // JPEG
+        QByteArray("\x89PNG", 4),             // PNG
+        QByteArray("GIF8", 4),                // GIF
+        QByteArray("RIFF", 4),                // WebP
+    };
+    for (const auto& magic : compressedMagics)
+        if (data.startsWith(magic)) return 0;
+    return 1; // 其他无损格式（如BMP）
+}
+
+QList<ClipFile> WireFormat::decodeFiles(const QJsonValue& value)
+{
+    QList<ClipFile> files;
+    for (const QJsonValue& item : value.toArray()) {
+        ClipFile file;
+        file.name = item.toObject().value("name").toString();
+        file.size = qint64(item.toObject().value("size").toDouble());
+        if (file.name.isEmpty() || file.size < 0) return {}; // 元数据不完整，整体丢弃
+        files << file;
+    }
+    return files;
+}
@@ -0,0 +1,94 @@
+#ifndef WIREFORMAT_H
+#define WIREFORMAT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+class PayloadCipher;
+class QJsonValue;
+class QJsonObject;
+
+// 文件列表中的一个文件（复制的文件，text/uri-list）
+struct ClipFile {
+    QString name; // 只有文件名，不含路径
+    qint64 size = 0;
+    QString path; // 仅发送端：本地路径，上传时从内存映射中流式读取
+};
+
+// 一条剪贴板消息（解码后的原始数据 + 元数据）
+struct ClipPayload {
+    QByteArray data; // 原始字节（文本为UTF-8，图像为编码后的文件数据）
+    bool isText = true;
+    QString os;
+    QString origin; // 发送设备ID，同一频道内多台设备时用于识别来源（旧服务端 / iOS快捷指令没有）
+    QString channel; // 所属频道（hashId），多路复用连接下发时携带
+    QString id; // 服务端分配的消息ID，用于重叠长轮询时去重（旧服务端没有）
+    QString deltaBase; // 非空时 data 为相对该基准的增量（见 DeltaSync），仅用于上传
+    QStringList deliveredTo; // 已经通过局域网直连送达的设备，云端不必再下发给它们（见 LanPeer），仅用于上传
+    QByteArray wire;    // 在线程池中预编码的请求体（见 CapturePipeline），仅用于上传
+    QByteArray wireKey; // 预编码所用的选项，与发送时不一致则重新编码
+    quint64 fingerprint = 0; // 原始内容指纹（见 CapturePipeline），上传成功后记入 EncodeCache
+    QList<ClipFile> files; // 非空时为文件列表（FlagFiles）：下发的消息只有元数据，内容按 id 另行下载（见 FileTransfer）
+    QString dataFile; // 非空时载荷超过接收内存上限，已转存到该临时文件（data 为空），由接收方负责删除（见 WireStreamDecoder）
+};
+
+// 线上传输格式
+// 1. JSON（兼容）：{"data": base64, "isText": bool, "os": str, "origin": str, "channel": str, "id": str}，膨胀33%；发送端直接编码进输出缓冲（加密时密文就地展开为 base64），接收端解析仍需多次整体拷贝
+// 2. 二进制帧（application/octet-stream）：
+//    | "DPAW" | ver:u8 | flags:u8 | metaLen:u16 | payloadLen:u32 | meta(JSON) | payload |
+//    多字节整数均为大端序；meta 是很小的 JSON 对象，用于存放扩展元数据（如 os, origin, channel, id）
+//    FlagDeflate：payload 为 qCompress() 格式（4字节大端原始长度 + zlib 流）
+//    FlagDelta：payload 为增量，meta.base 为基准文本的 SHA-256（只上传，服务端还原后再下发）
+//    FlagEncrypted：payload 为端到端加密的密文（见 PayloadCipher），先压缩后加密；JSON 格式用 "encrypted" / "deflate": true 表示
+//    FlagFiles：文件列表，meta.files = [{"name", "size"}]；上传时 payload 为各文件内容依次拼接（流式发送），下发时 payload 为空
+class WireFormat {
+private:
+    WireFormat() = delete;
+    friend class WireStreamDecoder; // 共用解码的收尾步骤
+
+public:
+    static constexpr const char* JSON_MIME = "application/json";
+    static constexpr const char* BINARY_MIME = "application/octet-stream";
+    static constexpr const char* ACCEPT = "application/octet-stream, application/json;q=0.9";
+    static constexpr int HEADER_SIZE = 12;
+    static constexpr quint8 VERSION = 1;
+
+    static constexpr int COMPRESS_THRESHOLD = 1024; // 小于1KB不压缩，收益不抵开销
+    static constexpr int MAX_BODY = 2 * 1024 * 1024; // 服务端限制的请求体大小
+
+    // 编码后不超过 MAX_BODY 的原始数据上限（JSON 需扣除 base64 膨胀；元数据、加密开销预留4KB）
+    static constexpr int maxDataSize(bool binary) { return binary ? MAX_BODY - 4096 : (MAX_BODY - 4096) / 4 * 3; }
+
+    enum Flag : quint8 {
+        FlagText = 0x01,
+        FlagDeflate = 0x02,
+        FlagDelta = 0x04,
+        FlagEncrypted = 0x08,
+        FlagFiles = 0x10,
+    };
+
+    // cipher 非空时端到端加密 payload
+    static QByteArray encodeJson(const ClipPayload& payload, const PayloadCipher* cipher = nullptr);
+    // compress：服务端通过 Accept-Encoding 响应头声明支持 deflate 时才允许压缩
+    static QByteArray encodeBinary(const ClipPayload& payload, bool compress = false, const PayloadCipher* cipher = nullptr);
+    // 文件列表帧的头部（header + meta），文件内容由调用方流式追加（见 FileUploadDevice）
+    static QByteArray encodeFileListHeader(const ClipPayload& payload);
+    // 根据 Content-Type（或魔数）自动选择解码方式，失败返回false；加密的消息需要 cipher
+    static bool decode(const QByteArray& body, const QString& contentType, ClipPayload* out, const PayloadCipher* cipher = nullptr);
+    static bool isBinary(const QByteArray& body, int offset = 0);
+
+private:
+    static bool decodeJson(const QByteArray& body, ClipPayload* out, const PayloadCipher* cipher);
+    static bool decodeBinary(const QByteArray& body, int offset, ClipPayload* out, const PayloadCipher* cipher);
+    // 收尾：out->data / payload 已是完整的（base64解码后的）载荷，填充元数据并解密、解压
+    static bool finishJson(const QJsonObject& json, ClipPayload* out, const PayloadCipher* cipher);
+    static bool finishBinary(quint8 flags, const QJsonObject& meta, const QByteArray& payload, ClipPayload* out, const PayloadCipher* cipher);
+    static bool decrypt(const char* sealed, int size, const PayloadCipher* cipher, QByteArray* out);
+    static QList<ClipFile> decodeFiles(const QJsonValue& value);
+    // 按内容选择压缩级别，0 表示不压缩（已压缩的图像格式、小数据）
+    static int deflateLevel(const ClipPayload& payload);
+};
+
+#endif // WIREFORMAT_H
@@ -0,0 +1,373 @@
+#include "wirestreamdecoder.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+#include <QDir>
+#include <QDebug>
+#include "payloadcipher.h"
+#include <cctype>
+#include <cstring>
+
+static const char MAGIC[4] = {'D', 'P', 'A', 'W'};
+
+// base64 字符 → 6位值；SKIP 为忽略的字符（空白等，与 QByteArray::fromBase64 一致）
+struct Base64Table {
+    static constexpr quint8 SKIP = 64;
+    static constexpr quint8 PAD = 65;
+    quint8 v[256];
+
+    constexpr Base64Table() : v() {
+        for (int i = 0; i < 256; i++) v[i] = SKIP;
+        for (int i = 0; i < 26; i++) {
+            v['A' + i] = quint8(i);
+            v['a' + i] = quint8(26 + i);
+        }
+        for (int i = 0; i < 10; i++) v['0' + i] = quint8(52 + i);
+        v[uchar('+')] = 62;
+        v[uchar('/')] = 63;
+        v[uchar('=')] = PAD;
+    }
+};
+static constexpr Base64Table BASE64;
+
+WireStreamDecoder::WireStreamDecoder(qint64 sizeHint, qint64 memoryCap)
+    : sizeHint(sizeHint)
+    , memoryCap(memoryCap)
+{
+}
+
+bool WireStreamDecoder::feed(const char* chunk, qint64 size)
+{
+    if (state == Failed) return false;
+    const char* p = chunk;
+    const char* end = chunk + size;
+    if (state == Start) { // 跳过心跳，按首字节判断格式（与 WireFormat::decode 一致）
+        while (p < end && isspace(uchar(*p)))
+            p++;
+        if (p == end) return true;
+        if (*p == '{') {
+            meta = "{";
+            state = JsonKey;
+            p++;
+        } else if (*p == MAGIC[0]) {
+            state = BinaryHeader;
+        } else {
+            return fail("Unknown wire format.");
+        }
+    }
+    fed += end - p;
+    if (!(state < JsonKey ? feedBinary(p, end) : feedJson(p, end))) return false;
+    peak = qMax(peak, qint64(data.capacity()) + meta.capacity() + scratch.capacity() + raw.capacity() + size);
+    return true;
+}
+
+bool WireStreamDecoder::finish(ClipPayload* out, const PayloadCipher* cipher)
+{
+    Q_ASSERT(out);
+    if (state == Failed) return false;
+    if (state == Start) return true; // 只有心跳
+    if (state != BinaryDone && state != JsonDone)
+        return fail(state < JsonKey ? "Truncated binary frame." : "Truncated JSON.");
+
+    const bool json = state == JsonDone;
+    QJsonObject fields;
+    if (json) {
+        meta += '}';
+        QJsonParseError err;
+        const QJsonDocument doc = QJsonDocument::fromJson(meta, &err);
+        if (err.error != QJsonParseError::NoError || !doc.isObject())
+            return fail("Malformed JSON: " + err.errorString());
+        fields = doc.object();
+    } else if (!meta.isEmpty()) {
+        fields = QJsonDocument::fromJson(meta).object();
+    }
+    if (!spill) {
+        if (!json) return WireFormat::finishBinary(flags, fields, data, out, cipher);
+        out->data = data;
+        return WireFormat::finishJson(fields, out, cipher);
+    }
+
+    // 已落盘：在文件上解密、解压，收尾时告诉 WireFormat 载荷已是明文
+    const bool encrypted = json ? fields.value("encrypted").toBool() : flags & WireFormat::FlagEncrypted;
+    const bool deflated = json ? fields.value("deflate").toBool() : flags & WireFormat::FlagDeflate;
+    if (!finishSpill(encrypted, deflated, cipher)) return false;
+    bool ok;
+    if (json) {
+        fields.remove("encrypted");
+        fields.remove("deflate");
+        out->data = data;
+        ok = WireFormat::finishJson(fields, out, cipher);
+    } else {
+        ok = WireFormat::finishBinary(quint8(flags & ~(WireFormat::FlagEncrypted | WireFormat::FlagDeflate)), fields, data, out, cipher);
+    }
+    if (!ok || !spill) return ok; // 解压后放得下，仍在内存中
+    out->data.clear();
+    out->dataFile = spill->fileName();
+    spill->setAutoRemove(false); // 交给接收方
+    spill.reset();
+    return true;
+}
+
+bool WireStreamDecoder::fail(const QString& reason)
+{
+    state = Failed;
+    error = reason;
+    data.clear();
+    spill.reset(); // 删除临时文件
+    return false;
+}
+
+bool WireStreamDecoder::output(const char* p, qint64 n)
+{
+    outputSize += n;
+    if (outputSize > MAX_PAYLOAD) return fail("Payload too large.");
+    if (!spill && memoryCap > 0 && outputSize > memoryCap && !startSpill()) return false;
+    if (!spill) {
+        data.append(p, int(n));
+        return true;
+    }
+    if (spill->write(p, n) != n) return fail("Unable to write temp file: " + spill->errorString());
+    return true;
+}
+
+bool WireStreamDecoder::startSpill()
+{
+    spill.reset(new QTemporaryFile(QDir::tempPath() + "/dogpaw-XXXXXX.recv"));
+    if (!spill->open()) return fail("Unable to create temp file: " + spill->errorString());
+    if (!data.isEmpty() && spill->write(data) != data.size()) return fail("Unable to write temp file: " + spill->errorString());
+    qDebug() << "Incoming payload exceeds the memory cap" << memoryCap << "B, spill to" << spill->fileName();
+    data = QByteArray(); // 释放已分配的缓冲
+    return true;
+}
+
+bool WireStreamDecoder::finishSpill(bool encrypted, bool deflated, const PayloadCipher* cipher)
+{
+    if (!spill->flush()) return fail("Unable to write temp file: " + spill->errorString());
+    if (encrypted) { // 密文、明文都映射到文件，解密不占用堆内存
+        if (!cipher) return fail("Encrypted payload, but end-to-end encryption is disabled.");
+        const int sealedSize = int(spill->size()); // 不超过 MAX_PAYLOAD
+        const int plainSize = PayloadCipher::openedSize(sealedSize);
+        QScopedPointer<QTemporaryFile> plain(new QTemporaryFile(QDir::tempPath() + "/dogpaw-XXXXXX.recv"));
+        uchar* src = spill->map(0, sealedSize);
+        uchar* dst = plainSize > 0 && plain->open() && plain->resize(plainSize) ? plain->map(0, plainSize) : nullptr;
+        const bool ok = src && dst && cipher->open(reinterpret_cast<const char*>(src), sealedSize, reinterpret_cast<char*>(dst));
+        if (src) spill->unmap(src);
+        if (dst) plain->unmap(dst);
+        if (!ok) return fail("Unable to decrypt payload (different UUID/UserID, or tampered).");
+        spill.swap(plain); // 密文文件随 plain 一起删除
+    }
+    if (deflated) {
+        // qUncompress 只能整块解压；只有 Dog-Paw 客户端会压缩（文本，压缩后受2MB请求体限制），解压后仍超过上限的重新落盘
+        spill->seek(0);
+        data = qUncompress(spill->readAll());
+        spill.reset();
+        if (data.isEmpty()) return fail("Corrupted deflate payload.");
+        if (memoryCap > 0 && data.size() > memoryCap && !startSpill()) return false;
+    }
+    if (spill) spill->close(); // 文件保留，释放句柄
+    return true;
+}
+
+bool WireStreamDecoder::feedBinary(const char*& p, const char* end)
+{
+    while (p < end) {
+        switch (state) {
+        case BinaryHeader: {
+            const int n = int(qMin<qint64>(end - p, WireFormat::HEADER_SIZE - scratch.size()));
+            scratch.append(p, n);
+            p += n;
+            if (scratch.size() < WireFormat::HEADER_SIZE) break;
+
+            const uchar* h = reinterpret_cast<const uchar*>(scratch.constData());
+            if (memcmp(h, MAGIC, 4) != 0) return fail("Bad binary frame magic.");
+            if (h[4] != WireFormat::VERSION) return fail(QString("Unsupported binary frame version: %1").arg(h[4]));
+            flags = h[5];
+            if (flags & WireFormat::FlagDelta) return fail("Unexpected delta frame."); // 增量只在上传方向出现
+            metaLen = qFromBigEndian<quint16>(h + 6);
+            payloadLen = qFromBigEndian<quint32>(h + 8);
+            if (payloadLen > MAX_PAYLOAD) return fail("Binary frame too large.");
+            meta.reserve(metaLen);
+            if (memoryCap > 0 && payloadLen > memoryCap) {
+                if (!startSpill()) return false; // 超过内存上限，直接写盘
+            } else {
+                data.reserve(int(payloadLen)); // 长度已知，一次分配到位
+            }
+            scratch.clear();
+            state = metaLen > 0 ? BinaryMeta : payloadLen > 0 ? BinaryPayload : BinaryDone;
+            break;
+        }
+        case BinaryMeta: {
+            const int n = int(qMin<qint64>(end - p, metaLen - meta.size()));
+            meta.append(p, n);
+            p += n;
+            if (meta.size() == metaLen)
+                state = payloadLen > 0 ? BinaryPayload : BinaryDone;
+            break;
+        }
+        case BinaryPayload: {
+            const qint64 n = qMin<qint64>(end - p, payloadLen - outputSize);
+            if (!output(p, n)) return false;
+            p += n;
+            if (outputSize == payloadLen)
+                state = BinaryDone;
+            break;
+        }
+        default: // 帧之后的数据忽略（与 WireFormat::decode 一致）
+            p = end;
+        }
+    }
+    return true;
+}
+
+bool WireStreamDecoder::feedJson(const char*& p, const char* end)
+{
+    while (p < end) {
+        const char c = *p;
+        switch (state) {
+        case JsonKey:
+            if (c == '"') {
+                scratch = "\"";
+                escaped = false;
+                state = JsonKeyString;
+            } else if (c == '}') {
+                state = JsonDone;
+            } else if (!isspace(uchar(c))) {
+                return fail("Malformed JSON: expected a field name.");
+            }
+            p++;
+            break;
+        case JsonKeyString: // 保留原样（含引号、转义），重新拼接时直接使用
+            scratch += c;
+            p++;
+            if (escaped) escaped = false;
+            else if (c == '\\') escaped = true;
+            else if (c == '"') state = JsonColon;
+            if (scratch.size() > 256) return fail("Malformed JSON: field name too long.");
+            break;
+        case JsonColon:
+            if (c == ':') state = JsonValue;
+            else if (!isspace(uchar(c))) return fail("Malformed JSON: expected ':'.");
+            p++;
+            break;
+        case JsonValue:
+            if (isspace(uchar(c))) {
+                p++;
+            } else if (c == '"' && scratch == "\"data\"") { // 载荷：边收边解码，不保留 base64 文本
+                p++;
+                const qint64 expected = qMin(sizeHint, MAX_PAYLOAD) / 4 * 3; // 解码后不会超过响应体的3/4
+                if (memoryCap > 0 && expected > memoryCap) {
+                    if (!startSpill()) return false;
+                } else if (expected > 0) {
+                    data.reserve(int(expected));
+                }
+                quad = 0;
+                quadLen = 0;
+                padded = false;
+                state = JsonData;
+            } else {
+                raw.clear();
+                inString = false;
+                escaped = false;
+                depth = 0;
+                state = JsonRaw;
+            }
+            break;
+        case JsonRaw:
+            if (inString) {
+                if (escaped) escaped = false;
+                else if (c == '\\') escaped = true;
+                else if (c == '"') inString = false;
+            } else if (depth == 0 && (c == ',' || c == '}')) { // 值结束，分隔符交给 JsonNext
+                if (meta.size() > 1) meta += ',';
+                meta += scratch + ':' + raw;
+                state = JsonNext;
+                break;
+            } else if (c == '"') {
+                inString = true;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                depth--;
+            }
+            raw += c;
+            p++;
+            if (raw.size() > MAX_FIELD) return fail("Malformed JSON: field too large.");
+            break;
+        case JsonNext:
+            if (c == ',') state = JsonKey;
+            else if (c == '}') state = JsonDone;
+            else if (!isspace(uchar(c))) return fail("Malformed JSON: expected ',' or '}'.");
+            p++;
+            break;
+        case JsonData:
+            if (!decodeBase64(p, end)) return false;
+            break;
+        case JsonDataEscape: // 有的服务端会把 '/' 转义为 "\/"；"\n" 等换行与空白一样忽略
+            p++;
+            state = JsonData;
+            if (c == '/') {
+                const char slash = '/';
+                const char* s = &slash;
+                if (!decodeBase64(s, s + 1)) return false;
+            } else if (c != 'n' && c != 'r' && c != 't') {
+                return fail("Malformed base64 data.");
+            }
+            break;
+        case JsonDone:
+            if (!isspace(uchar(c))) return fail("Malformed JSON: trailing data.");
+            p++;
+            break;
+        default:
+            return fail("Malformed JSON.");
+        }
+    }
+    return true;
+}
+
+bool WireStreamDecoder::decodeBase64(const char*& p, const char* end)
+{
+    // 先解码到栈上的小缓冲，再成批追加，避免每3个字节调用一次 append
+    char out[3 * 1024];
+    int n = 0;
+    while (p < end) {
+        const uchar c = uchar(*p);
+        if (c == '"' || c == '\\') break;
+        p++;
+        const quint8 v = BASE64.v[c];
+        if (v == Base64Table::PAD) {
+            padded = true;
+            continue;
+        }
+        if (v == Base64Table::SKIP || padded) continue;
+        quad = quad << 6 | v;
+        if (++quadLen == 4) {
+            out[n++] = char(quad >> 16);
+            out[n++] = char(quad >> 8);
+            out[n++] = char(quad);
+            quad = 0;
+            quadLen = 0;
+            if (n == int(sizeof(out))) {
+                if (!output(out, n)) return false;
+                n = 0;
+            }
+        }
+    }
+    if (n > 0 && !output(out, n)) return false;
+    if (p == end) return true;
+    if (*p++ == '\\') {
+        state = JsonDataEscape;
+        return true;
+    }
+    state = JsonNext; // 字段结束
+    return flushQuad();
+}
+
+bool WireStreamDecoder::flushQuad()
+{
+    // 末尾不足4个字符（省略了填充）：2个字符 → 1字节，3个 → 2字节，1个不构成字节
+    const char tail[2] = {char(quad >> (quadLen == 2 ? 4 : 10)), char(quad >> 2)};
+    const int n = quadLen == 2 ? 1 : quadLen == 3 ? 2 : 0;
+    quad = 0;
+    quadLen = 0;
+    return n == 0 || output(tail, n);
+}
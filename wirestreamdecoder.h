@@ -0,0 +1,86 @@
+#ifndef WIRESTREAMDECODER_H
+#define WIRESTREAMDECODER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QTemporaryFile>
+#include <QScopedPointer>
+#include "wireformat.h"
+
+class PayloadCipher;
+
+// 增量解码：随 readyRead 逐块喂入，不等响应结束，也不保留完整的响应体
+// - JSON：只解析顶层对象；"data" 字段边收边 base64 解码到输出缓冲，其余字段（都很小）原样收集，结束时一次性解析
+// - 二进制帧：读到帧头即按 payloadLen 预分配输出缓冲，之后只追加
+// 整体解码（readAll → fromJson → toString → toLatin1 → fromBase64）同时持有约4份载荷，这里只有输出缓冲一份（见 tools/decodebench）
+// 长轮询心跳（前导空白）直接跳过
+// 内存上限：解码结果超过 memoryCap 时转存到临时文件（ClipPayload::dataFile），之后的数据直接写盘，内存占用不随消息大小增长
+class WireStreamDecoder {
+    Q_DISABLE_COPY(WireStreamDecoder)
+
+public:
+    explicit WireStreamDecoder(qint64 sizeHint = -1, qint64 memoryCap = 0); // memoryCap <= 0 表示不落盘
+    void setSizeHint(qint64 sizeHint) { this->sizeHint = sizeHint; } // 已知响应体大小（Content-Length）时，JSON 的输出缓冲据此预分配
+
+    bool feed(const char* data, qint64 size); // 格式错误时返回false，之后的数据都会被忽略
+    bool feed(const QByteArray& chunk) { return feed(chunk.constData(), chunk.size()); }
+    // 响应结束时调用；只有空白（心跳 / 长轮询超时）时返回true，isEmpty() 为true，out 不变
+    // 落盘的消息：out->data 为空，out->dataFile 为解密、解压后的载荷文件，由接收方负责删除
+    bool finish(ClipPayload* out, const PayloadCipher* cipher);
+
+    bool isEmpty(void) const { return state == Start; }
+    qint64 wireSize(void) const { return fed; }
+    qint64 peakBytes(void) const { return peak; } // 解码期间自身缓冲区（含当前数据块）占用的最高值
+    QString errorString(void) const { return error; }
+
+    static constexpr qint64 MAX_PAYLOAD = 64 * 1024 * 1024; // 解码结果的硬上限（含落盘），超过视为损坏
+
+private:
+    bool fail(const QString& reason);
+    // 消费 [p, end)，p 随之前移
+    bool feedBinary(const char*& p, const char* end);
+    bool feedJson(const char*& p, const char* end);
+    bool decodeBase64(const char*& p, const char* end);
+    bool flushQuad(void);
+    bool output(const char* p, qint64 n); // 追加到输出缓冲，超过内存上限后改写临时文件
+    bool startSpill(void);
+    bool finishSpill(bool encrypted, bool deflated, const PayloadCipher* cipher);
+
+private:
+    enum State {
+        Start,
+        BinaryHeader, BinaryMeta, BinaryPayload, BinaryDone,
+        JsonKey, JsonKeyString, JsonColon, JsonValue, JsonRaw, JsonNext, JsonData, JsonDataEscape, JsonDone,
+        Failed
+    };
+    State state = Start;
+    qint64 sizeHint = -1;
+    qint64 memoryCap = 0;
+    qint64 outputSize = 0;
+    qint64 fed = 0;
+    qint64 peak = 0;
+    QString error;
+
+    QByteArray data;    // 输出：完整的（base64解码后的）载荷
+    QScopedPointer<QTemporaryFile> spill; // 超过内存上限后的输出，交给接收方前自动删除
+    QByteArray meta;    // 二进制帧的 meta；JSON 中除 data 以外的字段，重新拼成一个对象
+    QByteArray scratch; // 帧头 / 当前字段的名称（含引号）
+    QByteArray raw;     // 当前（非 data）字段的原始值
+
+    // 二进制帧
+    quint8 flags = 0;
+    int metaLen = 0;
+    qint64 payloadLen = 0;
+
+    // JSON
+    bool inString = false;
+    bool escaped = false;
+    int depth = 0;
+    quint32 quad = 0; // base64：尚未凑满4个字符的6位组
+    int quadLen = 0;
+    bool padded = false;
+
+    static constexpr int MAX_FIELD = 1024 * 1024; // 非 data 字段的上限（如文件列表）
+};
+
+#endif // WIRESTREAMDECODER_H